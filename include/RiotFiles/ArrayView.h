@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Read-only window onto elements somebody else owns. Does not keep them alive.
+template <typename T>
+class ArrayView
+{
+    const T* ptr;
+    size_t count;
+public:
+    ArrayView() : ptr(nullptr), count(0) {}
+    ArrayView(const T* data, size_t size) : ptr(data), count(size) {}
+
+    const T* data() const {
+        return ptr;
+    }
+    size_t size() const {
+        return count;
+    }
+    bool empty() const {
+        return count == 0;
+    }
+    const T* begin() const {
+        return ptr;
+    }
+    const T* end() const {
+        return ptr + count;
+    }
+    const T& operator[](size_t idx) const {
+        return ptr[idx];
+    }
+};
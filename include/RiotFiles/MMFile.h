@@ -1,14 +1,26 @@
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
+#include <stdexcept>
 #include <string>
 
-enum MMOpenMode {
+enum class MMOpenMode {
     read,
     readWrite
 };
 
+// How the mapping is going to be used. Only a hint, the OS is free to ignore it.
+enum class MMAccessHint {
+    normal,
+    // Read front to back once, lets the OS read ahead aggressively and drop pages behind.
+    sequential,
+    // Will be needed soon, start paging it in. Mapping with this hint prefaults the whole file.
+    willNeed
+};
+
 class MMFileException : public std::runtime_error{
 public:
     MMFileException(const std::string& msg) : runtime_error(msg) {}
@@ -16,15 +28,23 @@ public:
 
 class MMFile
 {
+#ifdef _WIN32
     HANDLE fileHandle;
     HANDLE mapHandle;
+#else
+    int fileDescriptor;
+    bool writable;
+#endif
     void* ptr;
     size_t fileSize;
 public:
-    MMFile(const std::string &path, MMOpenMode mode, size_t sizeToMap);
+    MMFile(const std::string &path, MMOpenMode mode, size_t sizeToMap, MMAccessHint hint = MMAccessHint::normal);
     ~MMFile();
     void dispose();
 
+    // Hint for a part of the mapping, see MMAccessHint.
+    void advise(MMAccessHint hint, size_t offset, size_t length);
+
     void* getPtr() {
         return ptr;
     }
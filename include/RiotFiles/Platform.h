@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Thin layer over the few file system operations that differ between Windows and POSIX.
+namespace Platform
+{
+#ifdef _WIN32
+    const char PathSeparator = '\\';
+#else
+    const char PathSeparator = '/';
+#endif
+
+    bool fileExists(const std::string& path);
+    // Returns false if the file could not be queried.
+    bool getFileSize(const std::string& path, unsigned long long& size);
+    // Last modification time in an OS specific unit; only good for comparing against itself.
+    bool getFileTime(const std::string& path, unsigned long long& modifiedTime);
+
+    // Creates the directory and all missing parents. Accepts both / and \ as separators.
+    bool createDirectories(const std::string& path);
+    // Renames from to to, replacing to if it exists. The replace is atomic where the OS allows it.
+    bool replaceFile(const std::string& from, const std::string& to);
+    bool deleteFile(const std::string& path);
+
+    // fopen, returns nullptr on failure.
+    FILE* openFile(const std::string& path, const char* mode);
+    // Copies length bytes from one open file to another at the given offsets, without moving either
+    // file position. Both may be the same file as long as toOffset <= fromOffset. Copies inside the
+    // kernel (copy_file_range) where it can, with large buffered reads and writes otherwise. Between
+    // two files on a file system that supports it, block aligned ranges are shared (FICLONERANGE).
+    bool copyFileRange(FILE* from, unsigned long long fromOffset, FILE* to, unsigned long long toOffset, unsigned long long length);
+    bool truncateFile(FILE* file, unsigned long long size);
+    // fseek/ftell with 64 bit positions. seekFile returns false on failure, tellFile returns -1.
+    bool seekFile(FILE* file, unsigned long long offset, int origin = SEEK_SET);
+    unsigned long long tellFile(FILE* file);
+
+    // alignment has to be a power of two. Returns nullptr on failure; free with alignedFree.
+    void* alignedAlloc(size_t size, size_t alignment);
+    void alignedFree(void* ptr);
+}
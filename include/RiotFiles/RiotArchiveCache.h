@@ -0,0 +1,80 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class RiotArchiveFile;
+
+// Cache of decompressed files, bounded by the total size of the cached contents.
+//
+// Split into shards with their own lock and LRU list so many threads can use it without all
+// fighting over one mutex. Contents are handed out as shared immutable buffers, evicting an
+// entry only drops the cache's reference.
+//
+// Entries are keyed on archive, archive generation and file index. RiotArchiveFile gets a new
+// generation every time it is (re)loaded, e.g. by apply(), so contents from before are never
+// handed out again; invalidate() frees their memory right away instead of waiting for eviction,
+// which RiotArchiveFileCollection::rebuildIndex does.
+class RiotArchiveCache
+{
+public:
+    typedef std::shared_ptr<const std::vector<char>> Buffer;
+
+    struct Stats {
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long evictions;
+        size_t bytes;
+        size_t entries;
+    };
+
+    RiotArchiveCache(size_t byteBudget, unsigned int shardCount = 16);
+
+    // Returns nullptr on a miss.
+    Buffer find(const RiotArchiveFile* archive, unsigned int generation, size_t fileIdx);
+    // Files bigger than a shard's share of the budget are not kept.
+    void insert(const RiotArchiveFile* archive, unsigned int generation, size_t fileIdx, const Buffer& buffer);
+
+    void invalidate(const RiotArchiveFile* archive);
+    void clear();
+
+    Stats getStats() const;
+
+private:
+    struct Key {
+        const RiotArchiveFile* archive;
+        unsigned int generation;
+        size_t fileIdx;
+
+        bool operator==(const Key& other) const {
+            return archive == other.archive && generation == other.generation && fileIdx == other.fileIdx;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    struct Entry {
+        Key key;
+        Buffer buffer;
+    };
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first.
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+        size_t bytes;
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long evictions;
+    };
+
+    Shard& shardFor(const Key& key);
+    void evict(Shard& shard, std::list<Entry>::iterator it);
+
+    size_t shardBudget;
+    unsigned int shardCount;
+    std::unique_ptr<Shard[]> shards;
+};
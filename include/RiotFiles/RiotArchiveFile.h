@@ -1,11 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <cstdio>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <stdexcept>
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+
+#include "RiotFiles/RiotArchiveCache.h"
+#include "RiotFiles/RiotCodec.h"
 
 //#include "MMFile.h"
 
@@ -21,46 +29,46 @@ namespace RAF
     struct Header_t
     {
         // Magic value used to identify the file type, must be 0x18BE0EF0
-        unsigned long	mMagic;
+        unsigned int	mMagic;
 
         // Version of the archive format, must be 1
-        unsigned long	mVersion;
+        unsigned int	mVersion;
     };
 
     // Table of contents appears directly after header
     struct TableOfContents_t
     {
         // An index that is used by the runtime, do not modify
-        unsigned long	mMgrIndex;
+        unsigned int	mMgrIndex;
 
         // Offset to the file list from the beginning of the file
-        unsigned long	mFileListOffset;
+        unsigned int	mFileListOffset;
 
         // Offset to the string table from the beginning of the file
-        unsigned long	mStringTableOffset;
+        unsigned int	mStringTableOffset;
     };
 
     // Header of the file list
     struct FileListHeader_t
     {
         // Number of entries in the list
-        unsigned long	mCount;
+        unsigned int	mCount;
     };
 
     // An entry in the file list describes a file that has been archived
     struct FileListEntry_t
     {
         // Hash of the string name
-        unsigned long	mHash;
+        unsigned int	mHash;
 
         // Offset to the start of the archived file in the data file
-        unsigned long	mOffset;
+        unsigned int	mOffset;
 
         // Size of this archived file
-        unsigned long	mSize;
+        unsigned int	mSize;
 
         // Index of the name of the archvied file in the string table
-        unsigned long	mFileNameStringTableIndex;
+        unsigned int	mFileNameStringTableIndex;
     };
 }
 
@@ -93,6 +101,11 @@ namespace StringTable
 }
 
 namespace RAF {
+    // The structures are read straight from disk, fields are 32 bit regardless of platform.
+    static_assert(sizeof(Header_t) == 8, "RAF::Header_t must match the on-disk layout");
+    static_assert(sizeof(FileListEntry_t) == 16, "RAF::FileListEntry_t must match the on-disk layout");
+    static_assert(sizeof(StringTable::ENTRY) == 8, "StringTable::ENTRY must match the on-disk layout");
+
     enum {
         MinDirectorySize = sizeof(RAF::Header_t)+sizeof(RAF::TableOfContents_t)+sizeof(RAF::FileListHeader_t)+sizeof(StringTable::HEADER)
     };
@@ -104,13 +117,87 @@ public:
     RiotArchiveFileException(const std::string& msg) : runtime_error(msg) {}    
 };
 
+// How apply() writes changes to disk.
+enum class RAFApplyMode {
+    // Writes a new .dat file holding only the files still in the archive, then swaps both files.
+    rewrite,
+    // Appends new files to the end of the existing .dat file and only replaces the directory file.
+    // Data of removed or replaced files is left behind as dead space, see compact().
+    append
+};
+
+// How much of a .dat file is still in use, see RiotArchiveFile::getSpaceInfo.
+struct RAFSpaceInfo {
+    unsigned long long dataSize;  // Size of the .dat file.
+    unsigned long long liveBytes; // Referenced by at least one file; shared data counts once.
+    unsigned long long deadBytes;
+    size_t holeCount;             // Unreferenced stretches, including one at the end.
+    unsigned long long firstHole; // Where the first of them starts, dataSize if there are none.
+
+    double getDeadRatio() const {
+        return dataSize ? double(deadBytes) / double(dataSize) : 0.0;
+    }
+};
+
+// What apply() did with the added files. Files with identical contents are compressed and stored
+// once, see RiotArchiveFile::getLastApplyStats.
+struct RAFApplyStats {
+    size_t filesAdded;
+    size_t filesWritten;               // Distinct contents among filesAdded.
+    unsigned long long sourceBytes;    // Size of all added files before compression.
+    unsigned long long duplicateBytes; // Part of sourceBytes that was not compressed again.
+    unsigned long long bytesWritten;   // Compressed data written to the .dat file.
+    unsigned long long bytesShared;    // Compressed data that would otherwise have been written again.
+
+    RAFApplyStats() : filesAdded(0), filesWritten(0), sourceBytes(0), duplicateBytes(0), bytesWritten(0), bytesShared(0) {}
+};
+
+// Read-only contents of a file in an archive. Stored files point straight into the mapped .dat file,
+// at whatever offset they have there, so with no particular alignment. Compressed ones point into a
+// buffer of their own. Either way the view keeps what it points at alive, so it
+// stays valid after closeArchiveFile or the archive going away. On Windows a mapped .dat file cannot
+// be replaced, so apply() fails while views into it are held.
+class RiotArchiveFileView {
+    std::shared_ptr<const void> owner;
+    const char* ptr;
+    size_t length;
+public:
+    RiotArchiveFileView() : ptr(nullptr), length(0) {}
+    RiotArchiveFileView(std::shared_ptr<const void> owner, const char* data, size_t size)
+        : owner(std::move(owner)), ptr(data), length(size) {}
+
+    const char* data() const {
+        return ptr;
+    }
+    size_t size() const {
+        return length;
+    }
+    bool empty() const {
+        return length == 0;
+    }
+    const char* begin() const {
+        return ptr;
+    }
+    const char* end() const {
+        return ptr + length;
+    }
+};
+
+// Reading is thread safe: any number of threads may call the const methods at the same time,
+// including on a RiotArchiveFileCollection. The .dat file is mapped once, by whichever reader gets
+// there first, and every read holds a reference to the mapping so closeArchiveFile cannot pull it
+// away mid-read. Anything that modifies the archive or collection (addFile, removeFile, apply,
+// addArchive, dispose) needs the caller to make sure nobody else is using it.
 class RiotArchiveFile
 {
     std::string path;
     std::unique_ptr<MMFile> directoryFile;
-    mutable std::unique_ptr<MMFile> archiveFile;
+    // Only touched through std::atomic_load/atomic_store; archiveMutex serializes opening and closing.
+    mutable std::shared_ptr<MMFile> archiveFile;
+    mutable std::mutex archiveMutex;
 
-    void openArchive() const;
+    // Returns the mapped .dat file, mapping it if needed. Keep the reference while reading.
+    std::shared_ptr<MMFile> openArchive() const;
 
     RAF::Header_t* header;
     RAF::TableOfContents_t* TOC;
@@ -119,6 +206,16 @@ class RiotArchiveFile
     StringTable::HEADER* stringListHeader;
     StringTable::ENTRY* stringListEntries;
 
+    // True if fileListEntries are ordered by mHash, which lets lookups binary search.
+    bool sortedByHash;
+
+    // Unique per load, so anything derived from the contents can tell if it is stale.
+    unsigned int generation;
+
+    bool isFileNamed(size_t fileIdx, const std::string& path) const;
+    // Expects a sanitized path.
+    bool findFile(const std::string& path, size_t& fileIdx) const;
+
 protected:
     RiotArchiveFile();
 public:
@@ -130,6 +227,8 @@ public:
 
     virtual void dispose();
 
+    //Opens the archive file (.dat) if not already open.
+    virtual void openArchiveFile() const;
     //Closes the archive file (.dat) if open; opened by reading content of a file in the archive.
     virtual void closeArchiveFile() const;
 
@@ -139,29 +238,81 @@ public:
     virtual size_t getStringCount() const {
         return stringListHeader->m_Count;
     }
+    const std::string& getPath() const {
+        return path;
+    }
+    // Changes every time the archive is loaded, which apply() does after writing.
+    unsigned int getGeneration() const {
+        return generation;
+    }
 
     virtual std::string getFileName(size_t fileIdx) const;
     virtual std::string getString(size_t stringIdx) const;
 
     virtual bool hasFile(const std::string& path) const;
     virtual size_t getFileIndex(const std::string& path) const;
+    // Size and offset of the file as stored in the .dat file, i.e. compressed.
     virtual size_t getFileSize(size_t fileIdx) const;
+    virtual size_t getFileOffset(size_t fileIdx) const;
     virtual std::vector<char> getFileContents(size_t fileIdx) const;
 
+    // Size of the file once decompressed. The RAF directory does not store it, so compressed files
+    // are inflated (without storing the output) to find out. Costs as much CPU as reading the file.
+    virtual size_t getFileContentsSize(size_t fileIdx) const;
+    // Decompresses straight into buffer, writing at most bufferSize bytes. Returns the full size of
+    // the file; when that is larger than bufferSize the output was cut short, grow and call again.
+    virtual size_t getFileContents(size_t fileIdx, void* buffer, size_t bufferSize) const;
+
+    // Tells stored files from compressed ones by their first bytes, without decompressing anything. A
+    // stored file that happens to start like compressed data is reported as such; reading it still works.
+    virtual RAFEncoding getFileEncoding(size_t fileIdx) const;
+    // Contents without any copying for stored files, inflated into a new buffer otherwise.
+    virtual RiotArchiveFileView getFileView(size_t fileIdx) const;
+
+    // Puts fileIdxs in the order their data sits in the .dat file, so reading them one after the
+    // other goes front to back instead of seeking all over.
+    virtual void sortByReadOrder(std::vector<size_t>& fileIdxs) const;
+    // Same order, but as positions into fileIdxs, which is left alone. The same file listed more
+    // than once keeps its positions in the order given.
+    std::vector<size_t> getReadOrder(const std::vector<size_t>& fileIdxs) const;
+    // Asks the OS to start reading the stored data of the file in the background. Returns right away.
+    virtual void prefetch(size_t fileIdx) const;
+
     virtual void extractFile(size_t fileIdx, const std::string& outPath) const;
     virtual void unpackArchive(const std::string& outPath) const;
+    // Like unpackArchive, but spreads the files over workerCount threads, 0 meaning one per core.
+    // Maps the archive files up front, so all of them need to fit in the address space at once.
+    // The threads take files in .dat order and prefetch ahead of themselves, so the archive is read
+    // front to back no matter how many of them there are.
+    virtual void unpackArchiveParallel(const std::string& outPath, unsigned int workerCount = 0) const;
 
+protected:
+    void extractFilesParallel(const std::vector<size_t>& fileIdxs, const std::vector<std::string>& outPaths, unsigned int workerCount) const;
 
 private:
     void load(const std::string& archivePath);
 
+    // Inflates into buffer, counting anything beyond bufferSize. If growBuffer is given, buffer is
+    // its storage and it is grown to fit the whole file instead.
+    size_t inflateFile(size_t fileIdx, char* buffer, size_t bufferSize, std::vector<char>* growBuffer) const;
+
+    // The codec data looks like it came from, nullptr for stored data.
+    const RiotCodec* findCodec(const void* data, size_t size) const;
+    std::vector<std::shared_ptr<const RiotCodec>> codecs;
+    std::shared_ptr<const RiotCodec> defaultCodec;
+    // zstd with the dictionary kept in the archive, tried before anything else. Set by load.
+    std::shared_ptr<const RiotCodec> dictionaryCodec;
+
 private:
     std::set<std::string> removeList;
     struct AddInfo {
         std::string sourcePath;
         std::string archivePath;
+        std::shared_ptr<const RiotCodec> codec; // nullptr for defaultCodec.
+        std::shared_ptr<const std::vector<char>> contents; // Used instead of sourcePath if set.
     };
     std::map<std::string, AddInfo> addList;
+    RAFApplyStats applyStats;
 
     struct NewFileEntry {
         NewFileEntry(std::string p) {
@@ -174,26 +325,104 @@ private:
         unsigned int hash;
     };
 
+    std::set<unsigned int> getRemovedFiles() const;
+    // Compresses everything in addList and writes it at the current position of archiveOut.
+    void compressAddedFiles(FILE* archiveOut, unsigned int workerCount, std::vector<NewFileEntry>& newArchiveFiles);
+    // Writes a directory file listing newArchiveFiles, sorting them by hash first.
+    void writeDirectory(const std::string& outPath, std::vector<NewFileEntry>& newArchiveFiles) const;
+    void applyRewrite(unsigned int workerCount);
+    void applyAppend(unsigned int workerCount);
+
+protected:
     static std::string sanitize(const std::string& path);
 public:
-    static unsigned int hashString(std::string str);
-    void apply();
-    void discard();
+    // What the last apply did with the files added to it.
+    RAFApplyStats getLastApplyStats() const {
+        return applyStats;
+    }
 
-    void addFile(const std::string& archivePath, const std::string& filePath);
+    static unsigned int hashString(const std::string& str);
+    // Writes pending adds and removes to disk. New files are compressed on workerCount threads,
+    // 0 meaning one per core; the result is the same regardless of the count.
+    void apply(unsigned int workerCount = 0, RAFApplyMode mode = RAFApplyMode::rewrite);
+    void discard();
+    RAFSpaceInfo getSpaceInfo() const;
+    // Rewrites the .dat file without the dead space append mode leaves behind, if at least minDeadRatio
+    // of it is dead. Returns whether it did. There must be no pending changes.
+    bool compact(double minDeadRatio = 0.0, unsigned int workerCount = 0);
+    // Same, but in place: only the data past the first hole is moved down, and the file is then cut
+    // short. Far less I/O than compact when the holes are near the end, as they are after appends.
+    // Not crash safe, an interrupted compactTail leaves the archive pointing at moved data.
+    bool compactTail(double minDeadRatio = 0.0);
+
+    // codec is what apply() compresses the file with, the archive's default codec if nullptr.
+    void addFile(const std::string& archivePath, const std::string& filePath, std::shared_ptr<const RiotCodec> codec = nullptr);
+    // zlib at level 9 unless changed, which is what the game expects.
+    void setDefaultCodec(std::shared_ptr<const RiotCodec> codec);
+    // Used before the built in codecs to recognize and read files written with a custom codec.
+    virtual void addCodec(std::shared_ptr<const RiotCodec> codec);
     void removeFile(const std::string& archivePath);
+
+    // Where an archive keeps its zstd dictionary, as a stored file.
+    static const char* const ZstdDictionaryPath;
+    // Stores dictionary in the archive on the next apply() and makes zstd with it the default codec.
+    // Whoever opens the archive later reads it back without being told. Files compressed with an
+    // earlier dictionary of the archive can no longer be read, add them again.
+    void setZstdDictionary(const std::vector<char>& dictionary, int level = 19);
+    // zstd with the archive's dictionary, nullptr if it has none. Pass it to addFile to use it.
+    std::shared_ptr<const RiotCodec> getDictionaryCodec() const {
+        return dictionaryCodec;
+    }
 };
 
 
 class RiotArchiveFileCollection : public RiotArchiveFile {
     bool buildIndex;
+
+    // Global file index of the first file in each of the archives, and how many files each has.
+    std::vector<size_t> archiveFileOffsets;
+    std::vector<size_t> archiveFileCounts;
+    // Archives from loadIndex are only opened on first use. getArchive creates them under this lock,
+    // lookups of archives already open do not take it.
+    std::vector<std::string> archivePaths;
+    mutable std::mutex archivesMutex;
+
+    struct IndexEntry {
+        size_t archiveIdx;
+        size_t fileIdx;
+    };
+    // Lowercased, sanitized path -> where it lives. Archives added later shadow earlier ones.
+    std::unordered_map<std::string, IndexEntry> index;
+
+    std::unique_ptr<RiotArchiveCache> cache;
+
+    // Given to archives as they are added, see addCodec.
+    std::vector<std::shared_ptr<const RiotCodec>> archiveCodecs;
+
+    // Index loaded by loadIndex, used instead of the index map while set.
+    std::unique_ptr<MMFile> indexFile;
+    bool findInIndexFile(const std::string& key, IndexEntry& entry) const;
+    // Offset and size of a file the index has an entry for, without opening its archive.
+    bool findInIndexFile(size_t archiveIdx, size_t fileIdx, size_t& offset, size_t& size) const;
+
+    static std::string indexKey(const std::string& path);
+    // Opens the archive if loadIndex left it closed.
+    RiotArchiveFile* getArchive(size_t archiveIdx) const;
+    // Finds the archive holding a global fileIdx and makes fileIdx local to it.
+    size_t archiveIndexForFile(size_t& fileIdx, const char* caller) const;
+    RiotArchiveFile* archiveForFile(size_t& fileIdx, const char* caller) const;
+    void indexArchive(size_t archiveIdx);
 public:
+    // With buildIndex, hasFile/getFileIndex are answered from a path index built by addArchive.
+    // When several archives contain a path, the one added last wins, like the game resolves overrides.
+    // Without it the first archive containing the path is used.
     RiotArchiveFileCollection(bool buildIndex);
-    virtual ~RiotArchiveFileCollection() { dispose(); }
+    virtual ~RiotArchiveFileCollection();
 
 
     virtual void dispose() override;
 
+    virtual void openArchiveFile() const override;
     virtual void closeArchiveFile() const override;
 
     virtual size_t getFileCount() const override;
@@ -203,13 +432,52 @@ public:
 
     virtual bool hasFile(const std::string& path) const override;
     virtual size_t getFileIndex(const std::string& path) const override;
+    virtual size_t getFileSize(size_t fileIdx) const override;
+    virtual size_t getFileOffset(size_t fileIdx) const override;
+    // Served from the cache when enabled.
     virtual std::vector<char> getFileContents(size_t fileIdx) const override;
+    virtual size_t getFileContentsSize(size_t fileIdx) const override;
+    virtual size_t getFileContents(size_t fileIdx, void* buffer, size_t bufferSize) const override;
+    virtual RAFEncoding getFileEncoding(size_t fileIdx) const override;
+    // Compressed files are served from the cache when enabled.
+    virtual RiotArchiveFileView getFileView(size_t fileIdx) const override;
+    // Archive by archive, in the order they were added.
+    virtual void sortByReadOrder(std::vector<size_t>& fileIdxs) const override;
+    virtual void prefetch(size_t fileIdx) const override;
     virtual void extractFile(size_t fileIdx, const std::string& outPath) const override;
     virtual void unpackArchive(const std::string& outPath) const override; // Tries to closeArchiveFile if cant map files.
+    virtual void unpackArchiveParallel(const std::string& outPath, unsigned int workerCount = 0) const override;
 
+    // Throws once loadIndex is in use, its index would not see the archive. rebuildIndex first.
     void addArchive(const std::string& path);
-    std::map<std::string, RiotArchiveFile*> archivesNamed;
-    std::vector<RiotArchiveFile*> archives;
+    // Goes to all archives, including those added later.
+    virtual void addCodec(std::shared_ptr<const RiotCodec> codec) override;
+    // Only needed if archives are modified after being added, addArchive keeps the index up to date.
+    // Also frees what the cache holds for them.
+    void rebuildIndex();
+
+    // Writes the merged path index (path -> archive, file, offset, size) to a single file, along with
+    // sizes and modification times of all archives.
+    void saveIndex(const std::string& indexPath) const;
+    // Adds the archives listed in an index written by saveIndex, using the index for lookups as is,
+    // without building anything. Returns false, leaving the collection empty, if the index is missing,
+    // broken or any archive changed since it was written; add the archives and saveIndex again then.
+    // Archives are only opened once a file is read from them, offsets and sizes come from the index.
+    // Only for an empty collection, and addArchive throws after it until rebuildIndex.
+    bool loadIndex(const std::string& indexPath);
+
+    // Keeps up to byteBudget bytes of decompressed files around, see RiotArchiveCache. Off by default.
+    void enableCache(size_t byteBudget, unsigned int shardCount = 16);
+    void disableCache();
+    // nullptr if the cache is not enabled.
+    RiotArchiveCache* getCache() const {
+        return cache.get();
+    }
+    // Contents that can be shared without copying, from the cache when enabled.
+    RiotArchiveCache::Buffer getSharedFileContents(size_t fileIdx) const;
+    // nullptr for archives loadIndex has not needed to open yet. Slots are set once, with release.
+    mutable std::map<std::string, RiotArchiveFile*> archivesNamed;
+    mutable std::deque<std::atomic<RiotArchiveFile*>> archives;
     
     //void addArchive(RiotArchiveFile* archive); // Not implemented, not sure about how to handle ownership.
 };
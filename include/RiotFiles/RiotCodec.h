@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// How a file is kept in the .dat file.
+enum class RAFEncoding {
+    stored, // Raw bytes, as added.
+    zlib,   // A zlib stream. The only compression Riot's own archives use.
+    zstd,   // A zstd frame, optionally made with a dictionary.
+    lz4,    // An LZ4 frame.
+    custom  // Anything else, from a codec added by the application.
+};
+
+// Compresses files going into an archive and decompresses them coming out. Which codec a file was
+// written with is not recorded anywhere, it is recognized by the first bytes of its data; files
+// that no codec recognizes are stored. Codecs are shared between threads and must be stateless.
+// Archives using anything but stored and zlib are not something the game can read.
+class RiotCodec
+{
+public:
+    // Returned by decompress for data that turned out not to be this codec's after all.
+    static const size_t NotEncoded = size_t(-1);
+
+    virtual ~RiotCodec() {}
+
+    virtual RAFEncoding getEncoding() const = 0;
+    // True if data starts the way output of this codec does. A stored file can look like that too,
+    // which decompress then reports.
+    virtual bool isEncoded(const void* data, size_t size) const = 0;
+    virtual void compress(const void* data, size_t size, std::vector<char>& out) const = 0;
+    // Decompresses into buffer, writing at most bufferSize bytes, and returns the full decompressed
+    // size. With growBuffer, buffer is its storage and it is resized to fit the whole file instead.
+    // Returns NotEncoded if the data is not a valid stream from the very start, throws if it goes
+    // bad later on.
+    virtual size_t decompress(const void* data, size_t size, char* buffer, size_t bufferSize, std::vector<char>* growBuffer) const = 0;
+
+    // Leaves files as they are.
+    static std::shared_ptr<const RiotCodec> stored();
+    static std::shared_ptr<const RiotCodec> zlib(int level = 9);
+    // A file made with a dictionary can only be read by a codec with the same dictionary, see
+    // RiotArchiveFile::setZstdDictionary for keeping one with an archive.
+    static std::shared_ptr<const RiotCodec> zstd(int level = 19, const std::vector<char>& dictionary = std::vector<char>());
+    static std::shared_ptr<const RiotCodec> lz4(int level = 9);
+
+    // Builds a zstd dictionary of at most dictionarySize bytes out of sample files, typically a few
+    // hundred of the small files of an archive.
+    static std::vector<char> trainZstdDictionary(const std::vector<std::string>& samplePaths, size_t dictionarySize = 112640);
+
+    // Tried in this order to recognize files when no codec of an archive's own matches.
+    static const std::vector<std::shared_ptr<const RiotCodec>>& getBuiltinCodecs();
+};
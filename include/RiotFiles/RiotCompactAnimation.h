@@ -0,0 +1,64 @@
+#pragma once
+
+#include "RiotFiles/RiotSkin.h"
+
+#include <string>
+#include <vector>
+
+// RiotAnimation packed into a single buffer for keeping lots of animations in memory.
+//
+// Rotation and position of every bone are stored as one of:
+// - constant: one value, when no frame differs from the first by more than the tolerance,
+// - linear: first and last value, when blending between those reproduces every frame within the
+//   tolerance,
+// - animated: a value per frame.
+// Animated values are stored frame major: everything needed for one frame sits together, so
+// sampling a frame reads one contiguous block. Animated rotations can be quantized to 48 bits
+// (smallest three, about 0.005 degrees at worst) instead of four floats.
+class RiotCompactAnimation
+{
+    std::vector<unsigned char> data;
+    unsigned int boneCount;
+    unsigned int frameCount;
+    unsigned int fps;
+    bool quantized;
+    size_t frameStride;
+    size_t framesOffset;
+
+    void readBone(size_t bone, size_t frame, ANM::BoneFrame_t& out) const;
+public:
+    struct Options {
+        Options() : quantizeRotations(true), rotationTolerance(1e-4f), positionTolerance(1e-4f) {}
+        bool quantizeRotations;
+        float rotationTolerance; // Radians.
+        float positionTolerance; // Same unit as the positions.
+    };
+
+    struct Stats {
+        size_t constantTracks;
+        size_t linearTracks;
+        size_t animatedTracks;
+        size_t bytes;
+    };
+
+    explicit RiotCompactAnimation(const RiotAnimation& animation, const Options& options = Options());
+
+    size_t getBoneCount() const {
+        return boneCount;
+    }
+    size_t getFrameCount() const {
+        return frameCount;
+    }
+    unsigned int getFps() const {
+        return fps;
+    }
+    std::string getBoneName(size_t bone) const;
+    // Rotation and position tracks counted separately, so twice the bones in total.
+    Stats getStats() const;
+
+    // Writes getBoneCount() transforms, in the bone order of the source animation.
+    void sampleFrame(size_t frame, ANM::BoneFrame_t* out) const;
+    // Same blending as RiotPoseEvaluator::evaluateTimes: normalized lerp for rotations, linear for
+    // positions, wrapping around or clamping at the ends.
+    void sampleTime(float time, bool loop, ANM::BoneFrame_t* out) const;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <iosfwd>
+
+class RiotSkin;
+class RiotSkeleton;
+class RiotAnimation;
+
+// Gets to look at every skin, skeleton and animation right after it is parsed. The loaders never
+// format or print anything themselves, they only hand the result to the sink, if one is set.
+// Define RIOTFILES_NO_DIAGNOSTICS when building the library to leave even that check out.
+class RiotDiagnostics
+{
+public:
+    virtual ~RiotDiagnostics() {}
+
+    virtual void loaded(const RiotSkin&) {}
+    virtual void loaded(const RiotSkeleton&) {}
+    virtual void loaded(const RiotAnimation&) {}
+
+    // nullptr, the default, turns diagnostics off. The sink is not owned, and is called from
+    // whatever thread does the loading, so it has to be thread safe if loading is.
+    static void setSink(RiotDiagnostics* sink);
+    static RiotDiagnostics* getSink();
+};
+
+// Dumps headers, counts and bone tables as text, one object after another.
+class RiotConsoleDiagnostics : public RiotDiagnostics
+{
+    std::ostream& out;
+public:
+    // Writes to std::cout when no stream is given.
+    RiotConsoleDiagnostics();
+    explicit RiotConsoleDiagnostics(std::ostream& out);
+
+    virtual void loaded(const RiotSkin& skin) override;
+    virtual void loaded(const RiotSkeleton& skeleton) override;
+    virtual void loaded(const RiotAnimation& animation) override;
+};
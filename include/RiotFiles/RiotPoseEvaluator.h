@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RiotFiles/RiotSkin.h"
+
+#include <vector>
+
+// 3x4 row major affine transform, laid out like SKL::Bone_t::mMatrix: three rows of rotation/scale
+// with the translation in the last column. Transforms column vectors.
+struct RiotBoneMatrix {
+    float m[12];
+};
+
+// Turns animation frames into bone matrices for a skeleton, many poses per call.
+//
+// Skeleton matrices are taken as the world space bind pose, animation frames as transforms relative
+// to the parent bone. Tracks are matched to skeleton bones by name; bones without a track stay in
+// their bind pose relative to their parent. RiotSkeleton::load guarantees parents come before their
+// children, so going through the bones by index visits the hierarchy top down.
+//
+// Poses are evaluated four at a time, one per SIMD lane, so bigger batches are cheaper per pose.
+// The skeleton is copied from, the animation is read on every call and has to outlive the evaluator.
+class RiotPoseEvaluator
+{
+    const RiotAnimation* animation;
+    std::vector<int> parents;
+    std::vector<int> tracks;                  // Animation bone per skeleton bone, -1 for none.
+    std::vector<RiotBoneMatrix> bindLocal;    // Used for bones without a track.
+    std::vector<RiotBoneMatrix> inverseBind;
+    std::vector<int> paletteBones;            // RiotSkeleton::boneIds.
+
+public:
+    enum class Output {
+        // World space transform per skeleton bone.
+        world,
+        // World space transform times inverse bind pose per skeleton bone, what skinning needs.
+        skinning,
+        // The skinning matrices in RiotSkeleton::boneIds order, which is what the bone indices of
+        // SKN vertices refer to. Ready to upload as a palette.
+        palette
+    };
+
+private:
+    // Which frames each pose blends between, and how far.
+    struct Samples;
+    void evaluate(const Samples& samples, Output output, RiotBoneMatrix* out) const;
+
+public:
+    RiotPoseEvaluator(const RiotSkeleton& skeleton, const RiotAnimation& animation);
+
+    // Number of matrices written per pose.
+    size_t getMatrixCount(Output output) const;
+
+    // Writes frameCount poses, getMatrixCount(output) matrices each, starting at firstFrame.
+    void evaluateFrames(size_t firstFrame, size_t frameCount, Output output, RiotBoneMatrix* out) const;
+    // Writes one pose per time, in seconds. Rotations are blended with normalized lerp, positions
+    // linearly. With loop, times wrap around and the last frame blends into the first, otherwise
+    // they are clamped to the animation.
+    void evaluateTimes(const float* times, size_t timeCount, Output output, bool loop, RiotBoneMatrix* out) const;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <bitset>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -9,24 +11,24 @@ namespace SKN {
 #pragma pack(push)
 #pragma pack(1)
     struct Header_t {
-        unsigned long mMagic;
+        unsigned int mMagic;
         unsigned short mVersion;
     };
     struct TableOfContents_t {
         unsigned short mObjectCount;
-        unsigned long mMaterialCount;
+        unsigned int mMaterialCount;
     };
 
     struct MaterialHeader_t {
         char mMaterialName[64];
-        unsigned long mStartVertex;
-        unsigned long mVertexCount;
-        unsigned long mStartIndex;
-        unsigned long mIndexCount;
+        unsigned int mStartVertex;
+        unsigned int mVertexCount;
+        unsigned int mStartIndex;
+        unsigned int mIndexCount;
     };
     struct MeshHeader_t {
-        unsigned long mIndexCount;
-        unsigned long mVertexCount;
+        unsigned int mIndexCount;
+        unsigned int mVertexCount;
     };
 
     struct Vertex_t {
@@ -42,6 +44,7 @@ namespace SKN {
         int i3;
     };
 #pragma pack(pop)
+    static_assert(sizeof(Vertex_t) == 52, "SKN::Vertex_t must match the on-disk layout");
 }
 
 namespace SKL {
@@ -107,6 +110,16 @@ public:
     std::vector<SKN::Vertex_t> vertices;
     SKN::EndData_t endData;
 
+    struct Stats {
+        size_t materialCount;
+        size_t vertexCount;
+        size_t indexCount;
+        unsigned int maxBoneIndex;
+        std::bitset<256> referencedBones; // Every bone index used by some vertex.
+    };
+    // Goes over all vertices to collect the bone indices, so not free.
+    Stats getStats() const;
+
     RiotSkin(const void* data, size_t length) { load(data, length); }
     ~RiotSkin() { dispose(); }
     void load(const void* data, size_t length);
@@ -122,6 +135,12 @@ public:
     std::vector<SKL::Bone_t> bones;
     std::vector<int> boneIds; //Used in version 2
 
+    struct Stats {
+        size_t boneCount;
+        size_t boneIdCount;
+    };
+    Stats getStats() const;
+
     RiotSkeleton(const void* data, size_t length) { load(data, length); }
     ~RiotSkeleton() { dispose(); }
     void load(const void* data, size_t length);
@@ -143,6 +162,14 @@ public:
 
     std::vector<Bone> bones;
 
+    struct Stats {
+        size_t boneCount;
+        size_t frameCount;
+        unsigned int fps;
+        float duration; // In seconds, 0 if fps is.
+    };
+    Stats getStats() const;
+
     RiotAnimation(const void* data, size_t length) { load(data, length); }
     ~RiotAnimation() { dispose(); }
 
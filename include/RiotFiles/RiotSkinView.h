@@ -0,0 +1,54 @@
+#pragma once
+
+#include "RiotFiles/ArrayView.h"
+#include "RiotFiles/RiotSkin.h"
+
+#include <memory>
+#include <string>
+
+// An SKN file read in place. The buffer is checked once when the view is made, after that the
+// materials, indices and vertices are handed out as views straight into it, nothing is copied.
+//
+// Only the layout is checked: that all sections fit in the buffer. Indices are not checked against
+// the vertex count, nor material ranges against the mesh.
+class RiotSkinView
+{
+    std::shared_ptr<const void> owner;
+    const SKN::Header_t* header;
+    const SKN::TableOfContents_t* toc;
+    const SKN::MeshHeader_t* meshHeader;
+    const SKN::EndData_t* endData;
+    ArrayView<SKN::MaterialHeader_t> materialHeaders;
+    ArrayView<unsigned short> indexArray;
+    ArrayView<SKN::Vertex_t> vertexArray;
+public:
+    // Points into data, which has to stay around for as long as the view is used, unless owner keeps
+    // it alive. The data must be at least 2 byte aligned, as heap and mapped buffers are.
+    RiotSkinView(const void* data, size_t length, std::shared_ptr<const void> owner = std::shared_ptr<const void>());
+
+    // Maps an extracted .skn file, the view keeps the mapping alive.
+    static RiotSkinView mapFile(const std::string& path);
+
+    const SKN::Header_t& getHeader() const {
+        return *header;
+    }
+    const SKN::TableOfContents_t& getTableOfContents() const {
+        return *toc;
+    }
+    const SKN::MeshHeader_t& getMeshHeader() const {
+        return *meshHeader;
+    }
+    // Only version 2 files have end data, nullptr otherwise.
+    const SKN::EndData_t* getEndData() const {
+        return endData;
+    }
+    ArrayView<SKN::MaterialHeader_t> materials() const {
+        return materialHeaders;
+    }
+    ArrayView<unsigned short> indices() const {
+        return indexArray;
+    }
+    ArrayView<SKN::Vertex_t> vertices() const {
+        return vertexArray;
+    }
+};
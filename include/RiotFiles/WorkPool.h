@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Header only on purpose, same reasoning as riotfiles.h: whatever includes it owns the threads.
+namespace WorkPool
+{
+    // 0 means one worker per core. Never more workers than items, never less than one.
+    inline unsigned int workerCount(unsigned int requested, size_t items) {
+        if (requested == 0) {
+            requested = std::thread::hardware_concurrency();
+        }
+        if (items < requested) {
+            requested = (unsigned int)items;
+        }
+        return requested ? requested : 1;
+    }
+
+    // Calls work(idx) for every idx in [0, count) using up to workerCount threads.
+    //
+    // Every worker starts out with its own contiguous slice of the range, and when that runs dry it
+    // steals half of what is left of the fullest other slice. That keeps all threads busy even when
+    // the cost of items differs by orders of magnitude.
+    //
+    // If work throws, the remaining items are abandoned and the first exception is rethrown here
+    // once all workers are done.
+    template <typename Work>
+    void parallelFor(size_t count, unsigned int workerCount, const Work& work) {
+        workerCount = WorkPool::workerCount(workerCount, count);
+        if (workerCount == 1) {
+            for (size_t idx = 0; idx < count; idx++) {
+                work(idx);
+            }
+            return;
+        }
+
+        struct Slice {
+            std::mutex mutex;
+            size_t begin;
+            size_t end;
+        };
+        std::unique_ptr<Slice[]> slices(new Slice[workerCount]);
+        for (unsigned int worker = 0; worker < workerCount; worker++) {
+            slices[worker].begin = count * worker / workerCount;
+            slices[worker].end = count * (worker + 1) / workerCount;
+        }
+
+        std::atomic<bool> failed(false);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto takeOwn = [&](unsigned int worker, size_t& idx) {
+            std::lock_guard<std::mutex> lock(slices[worker].mutex);
+            if (slices[worker].begin == slices[worker].end) {
+                return false;
+            }
+            idx = slices[worker].begin++;
+            return true;
+        };
+        auto steal = [&](unsigned int worker) {
+            // Pick the victim with the most left, the counts are only a guess until locked.
+            unsigned int victim = worker;
+            size_t most = 0;
+            for (unsigned int other = 0; other < workerCount; other++) {
+                std::lock_guard<std::mutex> lock(slices[other].mutex);
+                auto left = slices[other].end - slices[other].begin;
+                if (other != worker && left > most) {
+                    most = left;
+                    victim = other;
+                }
+            }
+            if (victim == worker) {
+                return false;
+            }
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> lock(slices[victim].mutex);
+                auto left = slices[victim].end - slices[victim].begin;
+                if (left == 0) {
+                    return true; // Raced with its owner, go look again.
+                }
+                end = slices[victim].end;
+                begin = end - (left + 1) / 2;
+                slices[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> lock(slices[worker].mutex);
+            slices[worker].begin = begin;
+            slices[worker].end = end;
+            return true;
+        };
+        auto run = [&](unsigned int worker) {
+            try {
+                size_t idx;
+                while (!failed) {
+                    if (takeOwn(worker, idx)) {
+                        work(idx);
+                    }
+                    else if (!steal(worker)) {
+                        break;
+                    }
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned int worker = 1; worker < workerCount; worker++) {
+            threads.push_back(std::thread(run, worker));
+        }
+        run(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
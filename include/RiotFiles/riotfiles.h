@@ -1,7 +1,16 @@
 #pragma once
 
-#include "RiotFiles\RiotArchiveFile.h"
-#include "RiotFiles\RiotSkin.h"
+#include "RiotFiles/RiotArchiveFile.h"
+#include "RiotFiles/RiotDiagnostics.h"
+#include "RiotFiles/RiotSkin.h"
+#include "RiotFiles/RiotSkinView.h"
+#include "RiotFiles/WorkPool.h"
+
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
 
 // These are inline. Why? Because they allocate data which needs to be deleted.
 // Because allocation and runtime.
@@ -11,13 +20,26 @@
 
 inline RiotSkin* loadRiotSkin(const RiotArchiveFile* archive, const std::string& path) {
     auto fileId = archive->getFileIndex(path);
-    auto content = archive->getFileContents(fileId);
+    auto content = archive->getFileView(fileId);
 
     return new RiotSkin(content.data(), content.size());
 }
 inline RiotSkin* loadRiotSkin(const std::vector<char>& content, const std::string& path) {
     return new RiotSkin(content.data(), content.size());
 }
+// The view points into the decompressed buffer (the cache's, for a collection with the cache on) for
+// compressed files, and into the mapped archive for stored ones. It keeps that buffer alive. Stored
+// files at an odd offset in the .dat file are the exception: they are copied, as RiotSkinView needs
+// 2 byte alignment.
+inline RiotSkinView loadRiotSkinView(const RiotArchiveFile* archive, const std::string& path) {
+    auto fileId = archive->getFileIndex(path);
+    auto content = std::make_shared<RiotArchiveFileView>(archive->getFileView(fileId));
+    if ((uintptr_t)content->data() & 1) {
+        auto copy = std::make_shared<std::vector<char>>(content->data(), content->data() + content->size());
+        return RiotSkinView(copy->data(), copy->size(), copy);
+    }
+    return RiotSkinView(content->data(), content->size(), content);
+}
 
 inline RiotSkeleton* loadRiotSkeleton(const RiotArchiveFile* archive, const std::string& path) {
     auto fileId = archive->getFileIndex(path);
@@ -38,3 +60,56 @@ inline RiotAnimation* loadRiotAnimation(const std::vector<char>& content, const
     return new RiotAnimation(content.data(), content.size());
 }
 
+// One asset out of loadRiotBatch: either the asset, or what went wrong loading it.
+template <typename T>
+struct RiotLoadResult {
+    std::unique_ptr<T> asset;
+    std::string error;
+
+    bool ok() const {
+        return asset != nullptr;
+    }
+};
+
+// Loads RiotSkin, RiotSkeleton or RiotAnimation assets for all paths at once, on workerCount threads,
+// 0 meaning one per core. Files are read in .dat order rather than in the order given, while
+// results come back in the order of paths. A missing or broken file fails only its own entry.
+template <typename T>
+std::vector<RiotLoadResult<T>> loadRiotBatch(const RiotArchiveFile* archive, const std::vector<std::string>& paths, unsigned int workerCount = 0) {
+    std::vector<RiotLoadResult<T>> results(paths.size());
+
+    // Resolve everything up front; each worker only touches the data of its own files.
+    std::vector<size_t> fileIdxs(paths.size());
+    std::vector<size_t> resolvedIdxs;
+    std::vector<size_t> resultIdxs;
+    for (size_t idx = 0; idx < paths.size(); idx++) {
+        try {
+            fileIdxs[idx] = archive->getFileIndex(paths[idx]);
+            resolvedIdxs.push_back(fileIdxs[idx]);
+            resultIdxs.push_back(idx);
+        }
+        catch (const std::exception& e) {
+            results[idx].error = e.what();
+        }
+    }
+
+    auto readOrder = archive->getReadOrder(resolvedIdxs);
+    std::vector<size_t> pending(readOrder.size());
+    for (size_t idx = 0; idx < readOrder.size(); idx++) {
+        pending[idx] = resultIdxs[readOrder[idx]];
+    }
+
+    // The pool hands each worker a contiguous run of pending, so every thread walks forward
+    // through its own stretch of the archive.
+    WorkPool::parallelFor(pending.size(), workerCount, [&](size_t idx) {
+        auto& result = results[pending[idx]];
+        try {
+            auto content = archive->getFileView(fileIdxs[pending[idx]]);
+            result.asset.reset(new T(content.data(), content.size()));
+        }
+        catch (const std::exception& e) {
+            result.error = e.what();
+        }
+    });
+    return results;
+}
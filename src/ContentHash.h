@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+// 128 bit hash of a block of memory, MurmurHash3 x64_128. Fast and good enough to tell files apart by
+// content, not meant to stand up to anyone crafting collisions. Blocks are read in native byte
+// order, so hashes are only comparable on the same kind of machine.
+struct ContentHash
+{
+    unsigned long long low;
+    unsigned long long high;
+
+    bool operator==(const ContentHash& other) const {
+        return low == other.low && high == other.high;
+    }
+
+    // For unordered containers; the bits are already well mixed.
+    struct Hasher {
+        size_t operator()(const ContentHash& hash) const {
+            return size_t(hash.low ^ hash.high);
+        }
+    };
+
+    static ContentHash compute(const void* data, size_t length, unsigned long long seed = 0) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        const unsigned long long c1 = 0x87c37b91114253d5ull;
+        const unsigned long long c2 = 0x4cf5ad432745937full;
+        unsigned long long h1 = seed;
+        unsigned long long h2 = seed;
+
+        size_t blocks = length / 16;
+        for (size_t idx = 0; idx < blocks; idx++) {
+            unsigned long long k1, k2;
+            memcpy(&k1, bytes + idx * 16, 8);
+            memcpy(&k2, bytes + idx * 16 + 8, 8);
+
+            k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+            h1 = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+            k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+            h2 = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+        }
+
+        const unsigned char* tail = bytes + blocks * 16;
+        unsigned long long k1 = 0;
+        unsigned long long k2 = 0;
+        size_t tailLength = length & 15;
+        for (size_t idx = tailLength; idx > 8; idx--) {
+            k2 ^= (unsigned long long)tail[idx - 1] << ((idx - 9) * 8);
+        }
+        if (tailLength > 8) {
+            k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+        }
+        for (size_t idx = tailLength < 8 ? tailLength : 8; idx > 0; idx--) {
+            k1 ^= (unsigned long long)tail[idx - 1] << ((idx - 1) * 8);
+        }
+        if (tailLength) {
+            k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+        }
+
+        h1 ^= (unsigned long long)length;
+        h2 ^= (unsigned long long)length;
+        h1 += h2;
+        h2 += h1;
+        h1 = mix(h1);
+        h2 = mix(h2);
+        h1 += h2;
+        h2 += h1;
+
+        ContentHash hash;
+        hash.low = h1;
+        hash.high = h2;
+        return hash;
+    }
+
+private:
+    static unsigned long long rotl(unsigned long long value, int count) {
+        return (value << count) | (value >> (64 - count));
+    }
+
+    static unsigned long long mix(unsigned long long k) {
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdull;
+        k ^= k >> 33;
+        k *= 0xc4ceb9fe1a85ec53ull;
+        k ^= k >> 33;
+        return k;
+    }
+};
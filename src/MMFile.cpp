@@ -1,13 +1,25 @@
-#include "RiotFiles\MMFile.h"
+#include "RiotFiles/MMFile.h"
 
-#define MMFenforce(cond, msg) if(!(cond)) { throw MMFileException((msg)); }
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-MMFile::MMFile(const std::string &path, MMOpenMode mode, size_t _sizeToMap)
+// Releases whatever got opened before throwing, the destructor does not run for a throwing constructor.
+#define MMFenforce(cond, msg) if(!(cond)) { dispose(); throw MMFileException((msg)); }
+
+#ifdef _WIN32
+
+MMFile::MMFile(const std::string &path, MMOpenMode mode, size_t _sizeToMap, MMAccessHint hint)
+    : fileHandle(INVALID_HANDLE_VALUE), mapHandle(NULL), ptr(nullptr), fileSize(0)
 {
-    auto desiredAccess = mode == read ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE;
-    auto shareMode = mode == read ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_WRITE;
-    auto createDisposition = mode == read ? OPEN_EXISTING : OPEN_ALWAYS;
-    fileHandle = CreateFile(path.c_str(), desiredAccess, shareMode, NULL, createDisposition, 0, NULL);
+    auto desiredAccess = mode == MMOpenMode::read ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE;
+    auto shareMode = mode == MMOpenMode::read ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_WRITE;
+    auto createDisposition = mode == MMOpenMode::read ? OPEN_EXISTING : OPEN_ALWAYS;
+    auto flags = hint == MMAccessHint::sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+    fileHandle = CreateFile(path.c_str(), desiredAccess, shareMode, NULL, createDisposition, flags, NULL);
     MMFenforce(fileHandle != INVALID_HANDLE_VALUE, "Could not open desired file: " + path);
     LARGE_INTEGER size;
     size.QuadPart = _sizeToMap;
@@ -18,31 +30,122 @@ MMFile::MMFile(const std::string &path, MMOpenMode mode, size_t _sizeToMap)
     MMFenforce(fileSize, std::string("File is of 0 size, cant map that! ") + path);
 
 
-    auto protectMode = mode == read ? PAGE_READONLY : PAGE_READWRITE;
+    auto protectMode = mode == MMOpenMode::read ? PAGE_READONLY : PAGE_READWRITE;
     mapHandle = CreateFileMapping(fileHandle, NULL, protectMode, size.HighPart, size.LowPart, NULL);
     MMFenforce(mapHandle != NULL, "Could not create file mapping for file " + path);
-    auto mapAccess = mode == read ? FILE_MAP_READ : FILE_MAP_WRITE;
+    auto mapAccess = mode == MMOpenMode::read ? FILE_MAP_READ : FILE_MAP_WRITE;
     ptr = MapViewOfFileEx(mapHandle, mapAccess, 0, 0, fileSize, NULL);
     MMFenforce(ptr != NULL, "Could not map view of file");
-}
 
+    if (hint == MMAccessHint::willNeed) {
+        advise(hint, 0, fileSize);
+    }
+}
 
-MMFile::~MMFile()
-{
-    dispose();
+void MMFile::advise(MMAccessHint hint, size_t offset, size_t length) {
+#if _WIN32_WINNT >= 0x0602
+    if (hint == MMAccessHint::willNeed && ptr && offset < fileSize) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = (char*)ptr + offset;
+        range.NumberOfBytes = length < fileSize - offset ? length : fileSize - offset;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
 }
 
 void MMFile::dispose() {
-    fileSize = 0;
     if (ptr) {
         FlushViewOfFile(ptr, fileSize);
         UnmapViewOfFile(ptr); ptr = nullptr;
     }
+    fileSize = 0;
     if (mapHandle != NULL) {
-        CloseHandle(mapHandle); mapHandle = INVALID_HANDLE_VALUE;
+        CloseHandle(mapHandle); mapHandle = NULL;
     }
     if (fileHandle != INVALID_HANDLE_VALUE) {
         CloseHandle(fileHandle); fileHandle = INVALID_HANDLE_VALUE;
     }
 }
 
+#else
+
+MMFile::MMFile(const std::string &path, MMOpenMode mode, size_t _sizeToMap, MMAccessHint hint)
+    : fileDescriptor(-1), writable(mode == MMOpenMode::readWrite), ptr(nullptr), fileSize(0)
+{
+    fileDescriptor = writable ? open(path.c_str(), O_RDWR | O_CREAT, 0644) : open(path.c_str(), O_RDONLY);
+    MMFenforce(fileDescriptor != -1, "Could not open desired file: " + path);
+
+    struct stat info;
+    MMFenforce(fstat(fileDescriptor, &info) == 0, "Could not get size of file: " + path);
+    fileSize = _sizeToMap ? _sizeToMap : (size_t)info.st_size;
+    MMFenforce(fileSize, std::string("File is of 0 size, cant map that! ") + path);
+
+    // Like CreateFileMapping, grow files opened for writing to the size asked for.
+    // Read-only mappings past the end would fault on access instead, so refuse them.
+    if ((size_t)info.st_size < fileSize) {
+        MMFenforce(writable, "Could not create file mapping for file " + path);
+        MMFenforce(ftruncate(fileDescriptor, (off_t)fileSize) == 0, "Could not create file mapping for file " + path);
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (hint == MMAccessHint::willNeed) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    auto protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    ptr = mmap(nullptr, fileSize, protection, flags, fileDescriptor, 0);
+    if (ptr == MAP_FAILED) {
+        ptr = nullptr;
+    }
+    MMFenforce(ptr != nullptr, "Could not map view of file");
+
+#ifdef MADV_HUGEPAGE
+    // Large read-only mappings can be backed by huge pages on file systems that support it,
+    // which saves a lot of TLB misses when jumping around a multi-GB .dat file. Failure is fine.
+    if (!writable && fileSize >= (2 << 20)) {
+        madvise(ptr, fileSize, MADV_HUGEPAGE);
+    }
+#endif
+    if (hint != MMAccessHint::normal) {
+        advise(hint, 0, fileSize);
+    }
+}
+
+void MMFile::advise(MMAccessHint hint, size_t offset, size_t length) {
+    if (!ptr || offset >= fileSize) {
+        return;
+    }
+    // madvise wants a page aligned start.
+    auto pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    auto start = offset - offset % pageSize;
+    length = (length < fileSize - offset ? length : fileSize - offset) + (offset - start);
+
+    int advice = MADV_NORMAL;
+    switch (hint) {
+    case MMAccessHint::sequential: advice = MADV_SEQUENTIAL; break;
+    case MMAccessHint::willNeed: advice = MADV_WILLNEED; break;
+    default: break;
+    }
+    madvise((char*)ptr + start, length, advice);
+}
+
+void MMFile::dispose() {
+    if (ptr) {
+        if (writable) {
+            msync(ptr, fileSize, MS_ASYNC);
+        }
+        munmap(ptr, fileSize); ptr = nullptr;
+    }
+    fileSize = 0;
+    if (fileDescriptor != -1) {
+        close(fileDescriptor); fileDescriptor = -1;
+    }
+}
+
+#endif
+
+MMFile::~MMFile()
+{
+    dispose();
+}
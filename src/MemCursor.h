@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Walks a file held in memory section by section. Every section is checked against what is left
+// in the buffer before it is touched, as a whole rather than field by field, and a short buffer
+// throws Exception. Nothing is assumed about alignment except by take().
+template <typename Exception>
+class MemCursor
+{
+    const char* ptr;
+    const char* end;
+    const char* fileType;
+
+public:
+    // fileType names the format in error messages.
+    MemCursor(const void* data, size_t length, const char* _fileType)
+        : ptr((const char*)data), end((const char*)data + length), fileType(_fileType)
+    {
+        if (!data && length) {
+            throw Exception(std::string("No data given for ") + fileType + " file");
+        }
+    }
+
+    size_t remaining() const {
+        return size_t(end - ptr);
+    }
+
+    // Throws unless count elements of elementSize bytes are left, without moving on.
+    void expect(size_t count, size_t elementSize, const char* section) const {
+        if (elementSize && count > remaining() / elementSize) {
+            throw Exception(std::string(fileType) + " file too short for " + section);
+        }
+    }
+
+    // Moves past count T and points at the first. The caller deals with alignment.
+    template <typename T>
+    const T* take(size_t count, const char* section) {
+        expect(count, sizeof(T), section);
+        auto first = (const T*)ptr;
+        ptr += count * sizeof(T);
+        return first;
+    }
+
+    template <typename T>
+    T read(const char* section) {
+        T value;
+        memcpy(&value, take<T>(1, section), sizeof(T));
+        return value;
+    }
+
+    // Replaces out with count T copied from the buffer.
+    template <typename T>
+    void copy(std::vector<T>& out, size_t count, const char* section) {
+        auto src = take<T>(count, section);
+        out.resize(count);
+        if (count) {
+            memcpy(out.data(), src, count * sizeof(T));
+        }
+    }
+};
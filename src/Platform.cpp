@@ -0,0 +1,281 @@
+#ifndef _WIN32
+// 64 bit off_t for fseeko/ftello, pread/pwrite and ftruncate on 32 bit systems too.
+#define _FILE_OFFSET_BITS 64
+#endif
+#include "RiotFiles/Platform.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <ShlObj.h>
+#include <io.h>
+#include <malloc.h>
+#else
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool Platform::fileExists(const std::string& path) {
+    return GetFileAttributes(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+bool Platform::getFileSize(const std::string& path, unsigned long long& size) {
+    WIN32_FILE_ATTRIBUTE_DATA fileData;
+    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &fileData)) {
+        return false;
+    }
+    size = ((unsigned long long)fileData.nFileSizeHigh << 32) | fileData.nFileSizeLow;
+    return true;
+}
+
+bool Platform::getFileTime(const std::string& path, unsigned long long& modifiedTime) {
+    WIN32_FILE_ATTRIBUTE_DATA fileData;
+    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &fileData)) {
+        return false;
+    }
+    modifiedTime = ((unsigned long long)fileData.ftLastWriteTime.dwHighDateTime << 32) | fileData.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+bool Platform::createDirectories(const std::string& _path) {
+    auto path = _path;
+    std::replace(path.begin(), path.end(), '/', '\\');
+    auto shError = SHCreateDirectoryEx(NULL, path.c_str(), NULL);
+    return shError == ERROR_SUCCESS || shError == ERROR_ALREADY_EXISTS;
+}
+
+bool Platform::replaceFile(const std::string& from, const std::string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+bool Platform::deleteFile(const std::string& path) {
+    return DeleteFileA(path.c_str()) != FALSE;
+}
+
+FILE* Platform::openFile(const std::string& path, const char* mode) {
+    FILE* file = nullptr;
+    if (fopen_s(&file, path.c_str(), mode)) {
+        return nullptr;
+    }
+    return file;
+}
+
+bool Platform::copyFileRange(FILE* from, unsigned long long fromOffset, FILE* to, unsigned long long toOffset, unsigned long long length) {
+    if (fflush(from) || fflush(to)) {
+        return false;
+    }
+    auto fromPosition = _ftelli64(from);
+    auto toPosition = _ftelli64(to);
+    // Reading a whole chunk before writing it keeps a move towards the start of the same file safe.
+    std::vector<char> buffer((size_t)std::min<unsigned long long>(length, 1 << 20));
+    bool ok = true;
+    while (ok && length) {
+        auto chunk = (size_t)std::min<unsigned long long>(length, buffer.size());
+        ok = _fseeki64(from, fromOffset, SEEK_SET) == 0 && fread(buffer.data(), 1, chunk, from) == chunk &&
+            _fseeki64(to, toOffset, SEEK_SET) == 0 && fwrite(buffer.data(), 1, chunk, to) == chunk && fflush(to) == 0;
+        fromOffset += chunk;
+        toOffset += chunk;
+        length -= chunk;
+    }
+    _fseeki64(from, fromPosition, SEEK_SET);
+    _fseeki64(to, toPosition, SEEK_SET);
+    return ok;
+}
+
+bool Platform::truncateFile(FILE* file, unsigned long long size) {
+    return fflush(file) == 0 && _chsize_s(_fileno(file), (__int64)size) == 0;
+}
+
+bool Platform::seekFile(FILE* file, unsigned long long offset, int origin) {
+    return _fseeki64(file, (__int64)offset, origin) == 0;
+}
+
+unsigned long long Platform::tellFile(FILE* file) {
+    return (unsigned long long)_ftelli64(file);
+}
+
+void* Platform::alignedAlloc(size_t size, size_t alignment) {
+    return _aligned_malloc(size, alignment);
+}
+
+void Platform::alignedFree(void* ptr) {
+    _aligned_free(ptr);
+}
+
+#else
+
+bool Platform::fileExists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+bool Platform::getFileSize(const std::string& path, unsigned long long& size) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    size = (unsigned long long)info.st_size;
+    return true;
+}
+
+bool Platform::getFileTime(const std::string& path, unsigned long long& modifiedTime) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+#ifdef __linux__
+    modifiedTime = (unsigned long long)info.st_mtim.tv_sec * 1000000000ull + (unsigned long long)info.st_mtim.tv_nsec;
+#else
+    modifiedTime = (unsigned long long)info.st_mtime;
+#endif
+    return true;
+}
+
+bool Platform::createDirectories(const std::string& path) {
+    if (path.empty()) {
+        return true;
+    }
+    std::string current;
+    current.reserve(path.size());
+    for (size_t idx = 0; idx <= path.size(); idx++) {
+        char ch = idx < path.size() ? path[idx] : '/';
+        if (ch == '\\') {
+            ch = '/';
+        }
+        // Make every prefix ending before a separator, skipping the root and empty components.
+        if (ch == '/' && !current.empty() && current.back() != '/') {
+            if (mkdir(current.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+        }
+        current += ch;
+    }
+    struct stat info;
+    return stat(current.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+bool Platform::replaceFile(const std::string& from, const std::string& to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+bool Platform::deleteFile(const std::string& path) {
+    return unlink(path.c_str()) == 0;
+}
+
+FILE* Platform::openFile(const std::string& path, const char* mode) {
+    return fopen(path.c_str(), mode);
+}
+
+bool Platform::copyFileRange(FILE* from, unsigned long long fromOffset, FILE* to, unsigned long long toOffset, unsigned long long length) {
+    if (fflush(from) || fflush(to)) {
+        return false;
+    }
+    int fromFd = fileno(from);
+    int toFd = fileno(to);
+
+    // The kernel refuses overlapping ranges within a file, so a move by less than length goes in
+    // steps of the distance; not worth the syscalls when that is small.
+    auto step = length;
+    if (from == to && fromOffset - toOffset < length) {
+        step = fromOffset - toOffset;
+    }
+#if defined(__linux__) && defined(FICLONERANGE)
+    struct stat info;
+    if (from != to && length && fstat(toFd, &info) == 0 && info.st_blksize > 0) {
+        auto blockSize = (unsigned long long)info.st_blksize;
+        if (fromOffset % blockSize == 0 && toOffset % blockSize == 0 && length % blockSize == 0) {
+            struct file_clone_range range;
+            range.src_fd = fromFd;
+            range.src_offset = fromOffset;
+            range.src_length = length;
+            range.dest_offset = toOffset;
+            if (ioctl(toFd, FICLONERANGE, &range) == 0) {
+                return true;
+            }
+        }
+    }
+#endif
+#if defined(__linux__) && defined(SYS_copy_file_range)
+    if (step >= (1 << 20) || step == length) {
+        while (length) {
+            long long inOffset = (long long)fromOffset;
+            long long outOffset = (long long)toOffset;
+            auto chunk = (size_t)std::min<unsigned long long>(std::min(length, step), 1ull << 30);
+            auto copied = syscall(SYS_copy_file_range, fromFd, &inOffset, toFd, &outOffset, chunk, 0u);
+            if (copied <= 0) {
+                // Not supported here (old kernel, across file systems, ...), finish the slow way.
+                break;
+            }
+            fromOffset += copied;
+            toOffset += copied;
+            length -= copied;
+        }
+    }
+#endif
+
+    // Reading a whole chunk before writing it keeps a move towards the start of the same file safe.
+    std::vector<char> buffer((size_t)std::min<unsigned long long>(length, 1 << 20));
+    while (length) {
+        auto chunk = (size_t)std::min<unsigned long long>(length, buffer.size());
+        for (size_t done = 0; done < chunk;) {
+            auto got = pread(fromFd, buffer.data() + done, chunk - done, (off_t)(fromOffset + done));
+            if (got <= 0) {
+                return false;
+            }
+            done += got;
+        }
+        for (size_t done = 0; done < chunk;) {
+            auto put = pwrite(toFd, buffer.data() + done, chunk - done, (off_t)(toOffset + done));
+            if (put <= 0) {
+                return false;
+            }
+            done += put;
+        }
+        fromOffset += chunk;
+        toOffset += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool Platform::truncateFile(FILE* file, unsigned long long size) {
+    return fflush(file) == 0 && ftruncate(fileno(file), (off_t)size) == 0;
+}
+
+bool Platform::seekFile(FILE* file, unsigned long long offset, int origin) {
+    return fseeko(file, (off_t)offset, origin) == 0;
+}
+
+unsigned long long Platform::tellFile(FILE* file) {
+    return (unsigned long long)ftello(file);
+}
+
+void* Platform::alignedAlloc(size_t size, size_t alignment) {
+    void* ptr = nullptr;
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+    if (posix_memalign(&ptr, alignment, size)) {
+        return nullptr;
+    }
+    return ptr;
+}
+
+void Platform::alignedFree(void* ptr) {
+    free(ptr);
+}
+
+#endif
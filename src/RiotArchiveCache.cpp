@@ -0,0 +1,107 @@
+#include "RiotFiles/RiotArchiveCache.h"
+
+#include <functional>
+
+RiotArchiveCache::RiotArchiveCache(size_t byteBudget, unsigned int _shardCount)
+    : shardCount(_shardCount ? _shardCount : 1)
+{
+    shardBudget = byteBudget / shardCount;
+    shards.reset(new Shard[shardCount]);
+    for (unsigned int idx = 0; idx < shardCount; idx++) {
+        shards[idx].bytes = 0;
+        shards[idx].hits = 0;
+        shards[idx].misses = 0;
+        shards[idx].evictions = 0;
+    }
+}
+
+size_t RiotArchiveCache::KeyHash::operator()(const Key& key) const {
+    auto hash = std::hash<const void*>()(key.archive);
+    hash ^= std::hash<size_t>()(key.fileIdx) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<unsigned int>()(key.generation) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+RiotArchiveCache::Shard& RiotArchiveCache::shardFor(const Key& key) {
+    // Mix the bits again, the low bits of the hash also pick the bucket inside the shard.
+    auto hash = KeyHash()(key);
+    return shards[(hash ^ (hash >> 16)) % shardCount];
+}
+
+void RiotArchiveCache::evict(Shard& shard, std::list<Entry>::iterator it) {
+    shard.bytes -= it->buffer->size();
+    shard.lookup.erase(it->key);
+    shard.entries.erase(it);
+}
+
+RiotArchiveCache::Buffer RiotArchiveCache::find(const RiotArchiveFile* archive, unsigned int generation, size_t fileIdx) {
+    Key key = { archive, generation, fileIdx };
+    auto& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.lookup.find(key);
+    if (it == shard.lookup.end()) {
+        shard.misses++;
+        return Buffer();
+    }
+    shard.hits++;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->buffer;
+}
+
+void RiotArchiveCache::insert(const RiotArchiveFile* archive, unsigned int generation, size_t fileIdx, const Buffer& buffer) {
+    if (!buffer || buffer->size() > shardBudget) {
+        return;
+    }
+    Key key = { archive, generation, fileIdx };
+    auto& shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.lookup.find(key) != shard.lookup.end()) {
+        // Another thread got here first with the same contents.
+        return;
+    }
+    while (shard.bytes + buffer->size() > shardBudget) {
+        evict(shard, std::prev(shard.entries.end()));
+        shard.evictions++;
+    }
+    Entry entry = { key, buffer };
+    shard.entries.push_front(entry);
+    shard.lookup[key] = shard.entries.begin();
+    shard.bytes += buffer->size();
+}
+
+void RiotArchiveCache::invalidate(const RiotArchiveFile* archive) {
+    for (unsigned int idx = 0; idx < shardCount; idx++) {
+        auto& shard = shards[idx];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+            auto current = it++;
+            if (current->key.archive == archive) {
+                evict(shard, current);
+            }
+        }
+    }
+}
+
+void RiotArchiveCache::clear() {
+    for (unsigned int idx = 0; idx < shardCount; idx++) {
+        auto& shard = shards[idx];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+        shard.lookup.clear();
+        shard.bytes = 0;
+    }
+}
+
+RiotArchiveCache::Stats RiotArchiveCache::getStats() const {
+    Stats stats = { 0, 0, 0, 0, 0 };
+    for (unsigned int idx = 0; idx < shardCount; idx++) {
+        auto& shard = shards[idx];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.bytes += shard.bytes;
+        stats.entries += shard.entries.size();
+    }
+    return stats;
+}
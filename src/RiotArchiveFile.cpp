@@ -1,13 +1,15 @@
-#include "RiotFiles\RiotArchiveFile.h"
-#include "RiotFiles\MMFile.h"
+#include "RiotFiles/RiotArchiveFile.h"
+#include "RiotFiles/MMFile.h"
+#include "RiotFiles/Platform.h"
+#include "RiotFiles/WorkPool.h"
+#include "ContentHash.h"
 
-#include "zlib\zlib.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
-#include <ShlObj.h>
-
 #define STRINGIZE_UGH(X) #X
 #define STRINGIZE(X) STRINGIZE_UGH(X)
 
@@ -23,11 +25,25 @@ bool compare(const std::string& a, const std::string& b) {
     return true;
 }
 
+// Same as above but against a \0-terminated name from the string table, avoids
+// building a std::string for every entry that is looked at.
+bool compare(const std::string& a, const char* b) {
+    for (unsigned int i = 0; i < a.size(); i++) {
+        if (!b[i] || tolower(a[i]) != tolower(b[i])) {
+            return false;
+        }
+    }
+    return b[a.size()] == 0;
+}
+
+
+// Shared by all archives so a generation is never reused, even by an archive at a recycled address.
+static std::atomic<unsigned int> nextGeneration(1);
 
-RiotArchiveFile::RiotArchiveFile(){
+RiotArchiveFile::RiotArchiveFile() : sortedByHash(false), generation(0), defaultCodec(RiotCodec::zlib()) {
 }
 
-RiotArchiveFile::RiotArchiveFile(const std::string& path)
+RiotArchiveFile::RiotArchiveFile(const std::string& path) : defaultCodec(RiotCodec::zlib())
 {
     load(path);
 }
@@ -70,11 +86,11 @@ void RiotArchiveFile::createEmptyFile(const std::string& path) {
 
 bool RiotArchiveFile::couldBeRAF(const std::string& path) {
 
-    WIN32_FILE_ATTRIBUTE_DATA fileData;
-    if (!GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &fileData)) {
+    unsigned long long fileSize;
+    if (!Platform::getFileSize(path, fileSize)) {
         return false;
     }
-    if (__int64(fileData.nFileSizeLow) + __int64(fileData.nFileSizeHigh) < RAF::MinDirectorySize) {
+    if (fileSize < RAF::MinDirectorySize) {
         return false;
     }
 
@@ -112,24 +128,46 @@ void RiotArchiveFile::load(const std::string& archivePath)
     directoryFile->get(fileListEntries, TOC->mFileListOffset + sizeof(RAF::FileListHeader_t));
     directoryFile->get(stringListEntries, TOC->mStringTableOffset + sizeof(StringTable::HEADER));
 
+    // apply() writes entries sorted by hash, and so does Riot. If that holds we can binary search
+    // in getFileIndex, otherwise fall back to looking at every entry.
+    sortedByHash = true;
+    for (size_t i = 1; i < fileListHeader->mCount; i++) {
+        if (fileListEntries[i - 1].mHash > fileListEntries[i].mHash) {
+            sortedByHash = false;
+            break;
+        }
+    }
 
     if (fileListHeader->mCount) {
         auto arcPath = archivePath + ".dat";
-        WIN32_FILE_ATTRIBUTE_DATA arcData;
-        RAFenforce(GetFileAttributesEx(arcPath.c_str(), GetFileExInfoStandard, &arcData), "Could not obtain size of .dat file!");
+        unsigned long long arcSize;
+        RAFenforce(Platform::getFileSize(arcPath, arcSize), "Could not obtain size of .dat file!");
     }
 
     path = archivePath;
+    generation = nextGeneration++;
+
+    dictionaryCodec.reset();
+    size_t dictionaryIdx;
+    if (findFile(sanitize(ZstdDictionaryPath), dictionaryIdx)) {
+        dictionaryCodec = RiotCodec::zstd(19, getFileContents(dictionaryIdx));
+    }
 }
 
 void RiotArchiveFile::dispose() {
     directoryFile.reset();
-    archiveFile.reset();
+    RiotArchiveFile::closeArchiveFile();
+
+}
 
+void RiotArchiveFile::openArchiveFile() const {
+    openArchive();
 }
 
 void RiotArchiveFile::closeArchiveFile() const {
-    archiveFile.reset(nullptr);
+    // Readers still holding the mapping keep it alive until they are done.
+    std::lock_guard<std::mutex> lock(archiveMutex);
+    std::atomic_store(&archiveFile, std::shared_ptr<MMFile>());
 }
 
 std::string RiotArchiveFile::getFileName(size_t fileIdx) const {
@@ -145,127 +183,310 @@ std::string RiotArchiveFile::getString(size_t stringIdx) const {
     return std::string(basePtr + entry->m_Offset);
 }
 
-const std::string getZLibError(int error) {
-    switch (error) {
-    case Z_OK: return "Z_OK: No error";
-    case Z_STREAM_END: return "Z_STREAM_END: The stream ended";
-    case Z_NEED_DICT: return "Z_NEED_DICT: Needs a dictionary";
-    case Z_ERRNO: return "Z_ERRNO: No idea";
-    case Z_STREAM_ERROR: return "Z_STREAM_ERROR: No idea";
-    case Z_DATA_ERROR: return "Z_DATA_ERROR: No idea";
-    case Z_MEM_ERROR: return "Z_MEM_ERROR: No idea";
-    case Z_BUF_ERROR: return "Z_BUF_ERROR: Check you're z_stream!";
-    case Z_VERSION_ERROR: return "Z_VERSION_ERROR: Mismatching version!";
-    default: return "Unrecognized ZLib-error";
-    }
-    return "No no";
+bool RiotArchiveFile::isFileNamed(size_t fileIdx, const std::string& path) const {
+    auto stringIdx = fileListEntries[fileIdx].mFileNameStringTableIndex;
+    RAFenforce(stringIdx < stringListHeader->m_Count, "Bad string index found in file list");
+    auto basePtr = (const char*)stringListHeader;
+    return compare(path, basePtr + stringListEntries[stringIdx].m_Offset);
 }
 
-bool RiotArchiveFile::hasFile(const std::string& _path) const {
-    auto path = sanitize(_path);
-    for (size_t i = 0; i < fileListHeader->mCount; i++) {
-        auto name = getFileName(i);
-        if (compare(path, name)) {
+bool RiotArchiveFile::findFile(const std::string& path, size_t& fileIdx) const {
+    auto count = fileListHeader->mCount;
+    if (sortedByHash) {
+        auto hash = hashString(path);
+        auto end = fileListEntries + count;
+        auto byHash = [](const RAF::FileListEntry_t& entry, unsigned int hash) {
+            return entry.mHash < hash;
+        };
+        // Only the entries sharing the hash need their names checked.
+        for (auto it = std::lower_bound(fileListEntries, end, hash, byHash); it != end && it->mHash == hash; ++it) {
+            auto idx = size_t(it - fileListEntries);
+            if (isFileNamed(idx, path)) {
+                fileIdx = idx;
+                return true;
+            }
+        }
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (isFileNamed(i, path)) {
+            fileIdx = i;
             return true;
         }
     }
     return false;
 }
 
+bool RiotArchiveFile::hasFile(const std::string& _path) const {
+    size_t fileIdx;
+    return findFile(sanitize(_path), fileIdx);
+}
+
 size_t RiotArchiveFile::getFileIndex(const std::string& _path) const {
-    // Can probably be accelerated by grabbing hash of path, looking
-    // in the file header until a match is found and then
-    // linearly search until found
     auto path = sanitize(_path);
-    for (size_t i = 0; i < fileListHeader->mCount; i++) {
-        auto name = getFileName(i);
-        if (compare(path, name)) {
-            return i;
-        }
+    size_t fileIdx;
+    if (findFile(path, fileIdx)) {
+        return fileIdx;
     }
     throw RiotArchiveFileException("Could not find file in archive: " + path);
 }
 
 size_t RiotArchiveFile::getFileSize(size_t fileIdx) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileSize");
     return fileListEntries[fileIdx].mSize;
 }
 
-void RiotArchiveFile::openArchive() const {
-    if (archiveFile) {
-        return;
+size_t RiotArchiveFile::getFileOffset(size_t fileIdx) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileOffset");
+    return fileListEntries[fileIdx].mOffset;
+}
+
+std::shared_ptr<MMFile> RiotArchiveFile::openArchive() const {
+    auto mapping = std::atomic_load(&archiveFile);
+    if (mapping) {
+        return mapping;
+    }
+    std::lock_guard<std::mutex> lock(archiveMutex);
+    mapping = std::atomic_load(&archiveFile);
+    if (mapping) {
+        return mapping;
     }
     auto arcPath = path + ".dat";
-    WIN32_FILE_ATTRIBUTE_DATA arcData;
-    RAFenforce(GetFileAttributesEx(arcPath.c_str(), GetFileExInfoStandard, &arcData), "Could not obtain size of .dat file!" + arcPath);
-    archiveFile.reset(new MMFile(arcPath, MMOpenMode::read, 0));
+    unsigned long long arcSize;
+    RAFenforce(Platform::getFileSize(arcPath, arcSize), "Could not obtain size of .dat file!" + arcPath);
+    mapping.reset(new MMFile(arcPath, MMOpenMode::read, 0));
+    std::atomic_store(&archiveFile, mapping);
+    return mapping;
 }
 
-std::vector<char> RiotArchiveFile::getFileContents(size_t fileIdx) const {
-    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileName");
-    auto entry = fileListEntries + fileIdx;
+const RiotCodec* RiotArchiveFile::findCodec(const void* data, size_t size) const {
+    if (dictionaryCodec && dictionaryCodec->isEncoded(data, size)) {
+        return dictionaryCodec.get();
+    }
+    for (const auto& codec : codecs) {
+        if (codec->isEncoded(data, size)) {
+            return codec.get();
+        }
+    }
+    for (const auto& codec : RiotCodec::getBuiltinCodecs()) {
+        if (codec->isEncoded(data, size)) {
+            return codec.get();
+        }
+    }
+    return nullptr;
+}
 
-    openArchive();
+void RiotArchiveFile::addCodec(std::shared_ptr<const RiotCodec> codec) {
+    RAFenforce(codec, "No codec given to addCodec");
+    codecs.push_back(codec);
+}
+
+void RiotArchiveFile::setDefaultCodec(std::shared_ptr<const RiotCodec> codec) {
+    RAFenforce(codec, "No codec given to setDefaultCodec");
+    defaultCodec = codec;
+}
+
+const char* const RiotArchiveFile::ZstdDictionaryPath = "riotfiles/zstd.dict";
+
+void RiotArchiveFile::setZstdDictionary(const std::vector<char>& dictionary, int level) {
+    RAFenforce(!dictionary.empty(), "Empty zstd dictionary given to setZstdDictionary");
+    auto codec = RiotCodec::zstd(level, dictionary);
+    auto archivePath = sanitize(ZstdDictionaryPath);
+    removeFile(archivePath);
+    AddInfo info;
+    info.archivePath = archivePath;
+    info.codec = RiotCodec::stored();
+    info.contents = std::make_shared<const std::vector<char>>(dictionary);
+    addList[archivePath] = info;
+    dictionaryCodec = codec;
+    defaultCodec = codec;
+}
 
-    byte* srcPtr;
-    archiveFile->get(srcPtr, entry->mOffset);
+RAFEncoding RiotArchiveFile::getFileEncoding(size_t fileIdx) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileEncoding");
+    auto entry = fileListEntries + fileIdx;
+    auto archive = openArchive();
+    char* srcPtr;
+    archive->get(srcPtr, entry->mOffset);
+    auto codec = findCodec(srcPtr, entry->mSize);
+    return codec ? codec->getEncoding() : RAFEncoding::stored;
+}
 
-    std::vector<char> outBuff;
+RiotArchiveFileView RiotArchiveFile::getFileView(size_t fileIdx) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileView");
+    auto entry = fileListEntries + fileIdx;
+    auto archive = openArchive();
+    char* srcPtr;
+    archive->get(srcPtr, entry->mOffset);
+    if (!findCodec(srcPtr, entry->mSize)) {
+        return RiotArchiveFileView(archive, srcPtr, entry->mSize);
+    }
+    auto contents = std::make_shared<const std::vector<char>>(getFileContents(fileIdx));
+    return RiotArchiveFileView(contents, contents->data(), contents->size());
+}
 
-    z_stream stream;
-    ZeroMemory(&stream, sizeof(stream));
-    inflateInit(&stream);
+size_t RiotArchiveFile::inflateFile(size_t fileIdx, char* buffer, size_t bufferSize, std::vector<char>* growBuffer) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileContents");
+    auto entry = fileListEntries + fileIdx;
 
-    stream.avail_in = entry->mSize;
-    stream.next_in = srcPtr;
+    auto archive = openArchive();
 
-    byte tmp[4000];
+    char* srcPtr;
+    archive->get(srcPtr, entry->mOffset);
 
-    bool doneAny = false;
-    do {
-        stream.avail_out = sizeof(tmp);
-        stream.next_out = tmp;
-        auto err = inflate(&stream, Z_NO_FLUSH);
-        if (err && err != Z_STREAM_END) {
-            if (!doneAny) {
-                outBuff.insert(outBuff.end(), srcPtr, srcPtr + entry->mSize);
-                inflateEnd(&stream);
-                return outBuff;
-            }
+    auto codec = findCodec(srcPtr, entry->mSize);
+    if (codec) {
+        auto total = codec->decompress(srcPtr, entry->mSize, buffer, bufferSize, growBuffer);
+        if (total != RiotCodec::NotEncoded) {
+            return total;
         }
-        RAFenforce(!err || err == Z_STREAM_END, "Error in deflate: " + getZLibError(err));
-        auto written = sizeof(tmp)-stream.avail_out;
-        outBuff.insert(outBuff.end(), tmp, tmp + written);
-        doneAny = true;
-    } while (!stream.avail_out);
-    inflateEnd(&stream);
+    }
+
+    // Stored, or a stored file that only looked compressed.
+    if (growBuffer) {
+        growBuffer->resize(entry->mSize);
+        buffer = growBuffer->data();
+        bufferSize = growBuffer->size();
+    }
+    memcpy(buffer, srcPtr, std::min<size_t>(entry->mSize, bufferSize));
+    return entry->mSize;
+}
+
+size_t RiotArchiveFile::getFileContentsSize(size_t fileIdx) const {
+    return inflateFile(fileIdx, nullptr, 0, nullptr);
+}
 
+size_t RiotArchiveFile::getFileContents(size_t fileIdx, void* buffer, size_t bufferSize) const {
+    return inflateFile(fileIdx, (char*)buffer, bufferSize, nullptr);
+}
+
+std::vector<char> RiotArchiveFile::getFileContents(size_t fileIdx) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to getFileContents");
+    // Start out assuming a compression ratio of 4 or so, grown by doubling if that is not enough.
+    std::vector<char> outBuff(std::max<size_t>(fileListEntries[fileIdx].mSize * 4, 4096));
+    inflateFile(fileIdx, outBuff.data(), outBuff.size(), &outBuff);
     return outBuff;
 }
 
 void makePath(std::string path, bool hasFilePart = false) {
-    std::replace(path.begin(), path.end(), '/', '\\');
     if (hasFilePart) {
-        path = path.substr(0, path.find_last_of('\\'));
+        path = path.substr(0, path.find_last_of("/\\"));
     }
-    auto shError = SHCreateDirectoryEx(NULL, path.c_str(), NULL);
-    RAFenforce(shError == ERROR_SUCCESS || shError == ERROR_ALREADY_EXISTS, "Could not create output directory while extracting file: " + path);
+    RAFenforce(Platform::createDirectories(path), "Could not create output directory while extracting file: " + path);
 }
 
-void RiotArchiveFile::extractFile(size_t fileIdx, const std::string& outPath) const {
-    auto content = getFileContents(fileIdx);
-    makePath(outPath, true);
+void writeFile(const std::string& outPath, const std::vector<char>& content) {
     std::ofstream outStream(outPath, std::ios::binary);
     RAFenforce(outStream.is_open(), "Failed to open file " + outPath);
     outStream.write(content.data(), content.size());
 }
 
+void RiotArchiveFile::extractFile(size_t fileIdx, const std::string& outPath) const {
+    auto content = getFileContents(fileIdx);
+    makePath(outPath, true);
+    writeFile(outPath, content);
+}
+
 
 void RiotArchiveFile::unpackArchive(const std::string& outPath) const {
-    auto totalFiles = this->getFileCount();
-    for (size_t fileIdx = 0; fileIdx < totalFiles; fileIdx++) {
+    // Directory order is hash order, which jumps all over the .dat file.
+    std::vector<size_t> fileIdxs(this->getFileCount());
+    for (size_t fileIdx = 0; fileIdx < fileIdxs.size(); fileIdx++) {
+        fileIdxs[fileIdx] = fileIdx;
+    }
+    this->sortByReadOrder(fileIdxs);
+    for (auto fileIdx : fileIdxs) {
         auto fileName = this->getFileName(fileIdx);
-        this->extractFile(fileIdx, outPath + "\\" + fileName);
+        this->extractFile(fileIdx, outPath + Platform::PathSeparator + fileName);
+    }
+}
+
+void RiotArchiveFile::sortByReadOrder(std::vector<size_t>& fileIdxs) const {
+    for (auto fileIdx : fileIdxs) {
+        RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to sortByReadOrder");
+    }
+    std::sort(fileIdxs.begin(), fileIdxs.end(), [this](size_t a, size_t b) {
+        return fileListEntries[a].mOffset < fileListEntries[b].mOffset;
+    });
+}
+
+std::vector<size_t> RiotArchiveFile::getReadOrder(const std::vector<size_t>& fileIdxs) const {
+    std::vector<size_t> readOrder(fileIdxs);
+    sortByReadOrder(readOrder);
+    std::unordered_map<size_t, size_t> readRank;
+    for (size_t idx = 0; idx < readOrder.size(); idx++) {
+        readRank.insert(std::make_pair(readOrder[idx], idx));
+    }
+    std::vector<size_t> order(fileIdxs.size());
+    for (size_t idx = 0; idx < order.size(); idx++) {
+        order[idx] = idx;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return readRank[fileIdxs[a]] < readRank[fileIdxs[b]];
+    });
+    return order;
+}
+
+void RiotArchiveFile::prefetch(size_t fileIdx) const {
+    RAFenforce(fileIdx < fileListHeader->mCount, "Bad fileIdx supplied to prefetch");
+    const auto& entry = fileListEntries[fileIdx];
+    openArchive()->advise(MMAccessHint::willNeed, entry.mOffset, entry.mSize);
+}
+
+void RiotArchiveFile::unpackArchiveParallel(const std::string& outPath, unsigned int workerCount) const {
+    auto totalFiles = getFileCount();
+    std::vector<size_t> fileIdxs(totalFiles);
+    std::vector<std::string> outPaths(totalFiles);
+    for (size_t fileIdx = 0; fileIdx < totalFiles; fileIdx++) {
+        fileIdxs[fileIdx] = fileIdx;
+        outPaths[fileIdx] = outPath + Platform::PathSeparator + getFileName(fileIdx);
+    }
+    extractFilesParallel(fileIdxs, outPaths, workerCount);
+}
+
+void RiotArchiveFile::extractFilesParallel(const std::vector<size_t>& fileIdxs, const std::vector<std::string>& outPaths, unsigned int workerCount) const {
+    // Lots of files share directories, make each of them once up front instead of once per file.
+    std::set<std::string> directories;
+    for (const auto& outPath : outPaths) {
+        directories.insert(outPath.substr(0, outPath.find_last_of("/\\")));
+    }
+    for (const auto& directory : directories) {
+        makePath(directory);
+    }
+
+    // Schedule the files in the order their data sits in the archive. Workers take the next file
+    // off the schedule one at a time, so together they read front to back; the output files are
+    // then written in parallel in whatever order they finish.
+    auto schedule = getReadOrder(fileIdxs);
+
+    // Map up front so the workers do not all start by queueing up on the first open.
+    openArchiveFile();
+
+    // Keeps the disk busy with the files a little further down the schedule while the current ones
+    // are inflated. Each file is prefetched once, by whoever takes the file PrefetchAhead before it.
+    const size_t PrefetchAhead = 64;
+    for (size_t idx = 0; idx < std::min(PrefetchAhead, schedule.size()); idx++) {
+        prefetch(fileIdxs[schedule[idx]]);
     }
+
+    std::atomic<size_t> next(0);
+    auto workers = WorkPool::workerCount(workerCount, schedule.size());
+    WorkPool::parallelFor(workers, workers, [&](size_t) {
+        try {
+            for (size_t idx = next++; idx < schedule.size(); idx = next++) {
+                if (idx + PrefetchAhead < schedule.size()) {
+                    prefetch(fileIdxs[schedule[idx + PrefetchAhead]]);
+                }
+                auto item = schedule[idx];
+                writeFile(outPaths[item], getFileContents(fileIdxs[item]));
+            }
+        }
+        catch (...) {
+            // Stop the others from taking new files.
+            next = schedule.size();
+            throw;
+        }
+    });
 }
 
 
@@ -276,7 +497,7 @@ std::string RiotArchiveFile::sanitize(const std::string& _path) {
     return path;
 }
 
-unsigned int RiotArchiveFile::hashString(std::string str) {
+unsigned int RiotArchiveFile::hashString(const std::string& str) {
     unsigned int hash = 0;
     unsigned int tmp;
     for (auto ch : str) {
@@ -311,40 +532,16 @@ void RiotArchiveFile::removeFile(const std::string& _archivePath) {
     removeList.insert(archivePath);
 }
 
-void RiotArchiveFile::addFile(const std::string& _archivePath, const std::string& filePath) {
+void RiotArchiveFile::addFile(const std::string& _archivePath, const std::string& filePath, std::shared_ptr<const RiotCodec> codec) {
     auto archivePath = sanitize(_archivePath);
     removeFile(archivePath);
-    addList[archivePath] = AddInfo{ filePath, archivePath };
+    addList[archivePath] = AddInfo{ filePath, archivePath, codec, nullptr };
 }
 
 
-unsigned int compress(const std::string& filePath, FILE* out) {
-    auto inFile = new MMFile(filePath, MMOpenMode::read, 0);
-    char* data = (char*)inFile->getPtr();
-    z_stream stream;
-    ZeroMemory(&stream, sizeof(stream));
-    deflateInit(&stream, 9);
-    
-    stream.avail_in = (unsigned int)inFile->getSize();
-    stream.next_in = (Bytef*)data;
-    char buff[4000];
-    unsigned int written = 0;
-    do {
-        stream.avail_out = sizeof(buff);
-        stream.next_out = (Bytef*)buff;
-        auto err = deflate(&stream, Z_FINISH);
-        if (err && err != Z_STREAM_END) {
-            //throw new ZlibException(err);
-            throw new RiotArchiveFileException("Error in deflate: " + getZLibError(err));
-        }
-        int toWrite = sizeof(buff) - stream.avail_out;
-        fwrite(buff, 1, toWrite, out);
-        written += toWrite;
-    } while (stream.avail_out == 0);
-
-    deflateEnd(&stream);
-    delete inFile;
-    return written;
+void compress(const std::string& filePath, const RiotCodec& codec, std::vector<char>& out) {
+    MMFile inFile(filePath, MMOpenMode::read, 0, MMAccessHint::sequential);
+    codec.compress(inFile.getPtr(), inFile.getSize(), out);
 }
 
 
@@ -366,63 +563,347 @@ unsigned int compress(const std::string& filePath, FILE* out) {
 
 
 
-void RiotArchiveFile::apply() {
+void RiotArchiveFile::apply(unsigned int workerCount, RAFApplyMode mode) {
     if (addList.empty() && removeList.empty()) {
         return;
     }
+    if (mode == RAFApplyMode::append) {
+        applyAppend(workerCount);
+    }
+    else {
+        applyRewrite(workerCount);
+    }
+}
 
-    openArchive();
+static void replaceWith(const std::string& from, const std::string& to) {
+    RAFenforce(Platform::fileExists(from), "Cant rename file, does not exist: " + from);
+    RAFenforce(Platform::replaceFile(from, to), "Could not rename file " + from + " to " + to);
+}
+
+bool RiotArchiveFile::compact(double minDeadRatio, unsigned int workerCount) {
+    RAFenforce(addList.empty() && removeList.empty(), "Apply or discard pending changes before compacting " + path);
+    auto info = getSpaceInfo();
+    if (info.deadBytes == 0 || info.getDeadRatio() < minDeadRatio) {
+        return false;
+    }
+    applyRewrite(workerCount);
+    return true;
+}
+
+// Entries by offset, which is the order both the analysis and the compactor walk the .dat file in.
+static std::vector<std::pair<size_t, size_t>> entriesByOffset(const RAF::FileListEntry_t* entries, size_t count) {
+    std::vector<std::pair<size_t, size_t>> order;
+    for (size_t fileIdx = 0; fileIdx < count; fileIdx++) {
+        order.push_back(std::make_pair(size_t(entries[fileIdx].mOffset), fileIdx));
+    }
+    std::sort(order.begin(), order.end());
+    return order;
+}
+
+RAFSpaceInfo RiotArchiveFile::getSpaceInfo() const {
+    RAFSpaceInfo info;
+    RAFenforce(Platform::getFileSize(path + ".dat", info.dataSize), "Could not get size of " + path + ".dat");
+    info.liveBytes = 0;
+    info.holeCount = 0;
+    info.firstHole = info.dataSize;
+
+    // Entries may overlap or share data, so count the union of their ranges.
+    unsigned long long covered = 0;
+    for (const auto& it : entriesByOffset(fileListEntries, fileListHeader->mCount)) {
+        const auto& entry = fileListEntries[it.second];
+        unsigned long long begin = entry.mOffset;
+        unsigned long long end = begin + entry.mSize;
+        if (!entry.mSize) {
+            continue;
+        }
+        if (begin > covered) {
+            info.holeCount++;
+            info.firstHole = std::min(info.firstHole, covered);
+        }
+        if (end > covered) {
+            info.liveBytes += end - std::max(begin, covered);
+            covered = end;
+        }
+    }
+    if (covered < info.dataSize) {
+        info.holeCount++;
+        info.firstHole = std::min(info.firstHole, covered);
+    }
+    info.liveBytes = std::min(info.liveBytes, info.dataSize);
+    info.deadBytes = info.dataSize - info.liveBytes;
+    return info;
+}
+
+bool RiotArchiveFile::compactTail(double minDeadRatio) {
+    RAFenforce(addList.empty() && removeList.empty(), "Apply or discard pending changes before compacting " + path);
+    auto info = getSpaceInfo();
+    if (info.deadBytes == 0 || info.getDeadRatio() < minDeadRatio) {
+        return false;
+    }
+
+    // Group entries into runs of touching or overlapping data, each of which moves down as a whole
+    // to right after the previous one. Runs before the first hole stay where they are.
+    struct Run {
+        size_t begin;
+        size_t end;
+        size_t newBegin;
+    };
+    std::vector<Run> runs;
+    std::vector<NewFileEntry> newArchiveFiles;
+    size_t writePosition = 0;
+    Run run = { 0, 0, 0 };
+    for (const auto& it : entriesByOffset(fileListEntries, fileListHeader->mCount)) {
+        const auto& entry = fileListEntries[it.second];
+        if (entry.mOffset > run.end) {
+            writePosition += run.end - run.begin;
+            runs.push_back(run);
+            run.begin = run.end = entry.mOffset;
+            run.newBegin = writePosition;
+        }
+        run.end = std::max<size_t>(run.end, size_t(entry.mOffset) + entry.mSize);
+
+        auto newEntry = NewFileEntry(getFileName(it.second));
+        newEntry.offset = (unsigned int)(run.newBegin + entry.mOffset - run.begin);
+        newEntry.size = entry.mSize;
+        newArchiveFiles.push_back(newEntry);
+    }
+    writePosition += run.end - run.begin;
+    runs.push_back(run);
+
+    // Directory first, so once the data is moved all that is left is the rename.
+    writeDirectory(path + ".tmp", newArchiveFiles);
+
+    closeArchiveFile();
+    FILE* datFile = Platform::openFile(path + ".dat", "r+b");
+    RAFenforce(datFile, "Could not open file for compacting:" + (path + ".dat"));
+    bool ok = true;
+    for (const auto& run : runs) {
+        if (ok && run.newBegin != run.begin) {
+            ok = Platform::copyFileRange(datFile, run.begin, datFile, run.newBegin, run.end - run.begin);
+        }
+    }
+    ok = ok && Platform::truncateFile(datFile, writePosition);
+    ok = fclose(datFile) == 0 && ok;
+    RAFenforce(ok, "Failed to move data while compacting " + path + ".dat");
+
+    auto origPath = path;
+    dispose();
+    replaceWith(origPath + ".tmp", origPath);
+    load(origPath);
+    return true;
+}
+
+void RiotArchiveFile::compressAddedFiles(FILE* archiveOut, unsigned int workerCount, std::vector<NewFileEntry>& newArchiveFiles) {
+    std::vector<const AddInfo*> toAdd;
+    for (const auto& it : addList) {
+        toAdd.push_back(&it.second);
+    }
+    auto workers = WorkPool::workerCount(workerCount, toAdd.size());
+
+    std::vector<const RiotCodec*> addCodecs(toAdd.size());
+    for (size_t idx = 0; idx < toAdd.size(); idx++) {
+        addCodecs[idx] = toAdd[idx]->codec ? toAdd[idx]->codec.get() : defaultCodec.get();
+    }
+
+    // Files with the same content and codec are compressed and written once, all their paths
+    // pointing at the same data. The first of them in addList order is the one written.
+    std::vector<ContentHash> hashes(toAdd.size());
+    std::vector<unsigned long long> sourceSizes(toAdd.size());
+    WorkPool::parallelFor(toAdd.size(), workers, [&](size_t idx) {
+        if (toAdd[idx]->contents) {
+            const auto& contents = *toAdd[idx]->contents;
+            sourceSizes[idx] = contents.size();
+            hashes[idx] = ContentHash::compute(contents.data(), contents.size());
+            return;
+        }
+        MMFile inFile(toAdd[idx]->sourcePath, MMOpenMode::read, 0, MMAccessHint::sequential);
+        sourceSizes[idx] = inFile.getSize();
+        hashes[idx] = ContentHash::compute(inFile.getPtr(), inFile.getSize());
+    });
+    std::map<const RiotCodec*, std::unordered_map<ContentHash, size_t, ContentHash::Hasher>> firstWithHash;
+    std::vector<size_t> sameAs(toAdd.size());
+    std::vector<size_t> unique;
+    for (size_t idx = 0; idx < toAdd.size(); idx++) {
+        auto it = firstWithHash[addCodecs[idx]].insert(std::make_pair(hashes[idx], idx));
+        sameAs[idx] = it.first->second;
+        if (it.second) {
+            unique.push_back(idx);
+        }
+    }
+
+    applyStats = RAFApplyStats();
+    applyStats.filesAdded = toAdd.size();
+    applyStats.filesWritten = unique.size();
+
+    // Compress on all workers, but write in addList order so the output does not depend on timing.
+    // Goes in batches to keep only a bounded number of compressed files in memory.
+    std::vector<unsigned int> offsets(toAdd.size());
+    std::vector<unsigned int> sizes(toAdd.size());
+    auto batchSize = size_t(workers) * 8;
+    std::vector<std::vector<char>> compressed(batchSize);
+    for (size_t first = 0; first < unique.size(); first += batchSize) {
+        auto count = std::min(batchSize, unique.size() - first);
+        WorkPool::parallelFor(count, workers, [&](size_t idx) {
+            const auto& info = *toAdd[unique[first + idx]];
+            const auto& codec = *addCodecs[unique[first + idx]];
+            if (info.contents) {
+                codec.compress(info.contents->data(), info.contents->size(), compressed[idx]);
+            }
+            else {
+                compress(info.sourcePath, codec, compressed[idx]);
+            }
+        });
+        for (size_t idx = 0; idx < count; idx++) {
+            auto offset = Platform::tellFile(archiveOut);
+            // Offsets in the directory are 32 bit.
+            RAFenforce(offset != (unsigned long long)-1 && offset + compressed[idx].size() <= 0xFFFFFFFFull, "Archive data would grow past 4GB: " + path + ".dat");
+            RAFenforce(fwrite(compressed[idx].data(), 1, compressed[idx].size(), archiveOut) == compressed[idx].size(), "Could not write to " + path + ".dat");
+            offsets[unique[first + idx]] = (unsigned int)offset;
+            sizes[unique[first + idx]] = (unsigned int)compressed[idx].size();
+            applyStats.bytesWritten += compressed[idx].size();
+        }
+    }
+
+    for (size_t idx = 0; idx < toAdd.size(); idx++) {
+        auto entry = NewFileEntry(toAdd[idx]->archivePath);
+        entry.offset = offsets[sameAs[idx]];
+        entry.size = sizes[sameAs[idx]];
+        newArchiveFiles.push_back(entry);
 
-    //int fileCountDiff = (int)addList.size() - (int)removeList.size();
-    //unsigned int finalFileCount = fileListHeader->mCount + fileCountDiff;
+        applyStats.sourceBytes += sourceSizes[idx];
+        if (sameAs[idx] != idx) {
+            applyStats.duplicateBytes += sourceSizes[idx];
+            applyStats.bytesShared += sizes[sameAs[idx]];
+        }
+    }
+}
 
+std::set<unsigned int> RiotArchiveFile::getRemovedFiles() const {
     std::set<unsigned int> toRemoveId;
-    for(const auto& removePath : removeList) {
+    for (const auto& removePath : removeList) {
         auto fileIndex = getFileIndex(removePath);
         toRemoveId.insert((unsigned int)fileIndex);
     }
+    return toRemoveId;
+}
 
+void RiotArchiveFile::applyRewrite(unsigned int workerCount) {
+    auto toRemoveId = getRemovedFiles();
 
-    FILE* archiveOut = nullptr;
-    fopen_s(&archiveOut, (path + ".tmp.dat").c_str(), "wb");
+    FILE* archiveIn = Platform::openFile(path + ".dat", "rb");
+    RAFenforce(archiveIn, "Could not open file:" + (path + ".dat"));
+    FILE* archiveOut = Platform::openFile(path + ".tmp.dat", "wb");
+    if (!archiveOut) {
+        fclose(archiveIn);
+    }
     RAFenforce(archiveOut, "Could not create file:" + (path + ".tmp.dat"));
 
+    // Surviving files are carried over in offset order, touching or overlapping data merged into
+    // runs that are copied in one go. Copying file to file lets the kernel do it, or share the
+    // blocks where the file system can. Files sharing data keep sharing it.
     std::vector<NewFileEntry> newArchiveFiles;
-    for (unsigned int fileIdx = 0; fileIdx < fileListHeader->mCount; fileIdx++) {
-        if (toRemoveId.find(fileIdx) != toRemoveId.end()) {
+    unsigned long long writePosition = 0;
+    unsigned long long runBegin = 0;
+    unsigned long long runEnd = 0;
+    bool ok = true;
+    auto copyRun = [&]() {
+        ok = ok && Platform::copyFileRange(archiveIn, runBegin, archiveOut, writePosition, runEnd - runBegin);
+        writePosition += runEnd - runBegin;
+    };
+    for (const auto& it : entriesByOffset(fileListEntries, fileListHeader->mCount)) {
+        const auto& entry = fileListEntries[it.second];
+        if (!entry.mSize || toRemoveId.find((unsigned int)it.second) != toRemoveId.end()) {
             continue;
         }
-        auto onlyEarlier = [&](unsigned int a[2]) {
-            return a[0] < fileListEntries[fileIdx].mOffset;
-        };
-
-        RAF::FileListEntry_t entry = fileListEntries[fileIdx];
+        if (entry.mOffset > runEnd) {
+            copyRun();
+            runBegin = runEnd = entry.mOffset;
+        }
+        runEnd = std::max(runEnd, (unsigned long long)entry.mOffset + entry.mSize);
 
-        if (entry.mSize) {
-            auto size = entry.mSize;
-            auto src = (char*)archiveFile->getPtr() + entry.mOffset;
-            auto offset = ftell(archiveOut);
-            fwrite(src, 1, size, archiveOut);
-            auto archivePath = getFileName(fileIdx);
+        auto newEntry = NewFileEntry(getFileName(it.second));
+        newEntry.offset = (unsigned int)(writePosition + entry.mOffset - runBegin);
+        newEntry.size = entry.mSize;
+        newArchiveFiles.push_back(newEntry);
+    }
+    copyRun();
+    fclose(archiveIn);
+    if (!ok || !Platform::seekFile(archiveOut, writePosition)) {
+        fclose(archiveOut);
+        RAFenforce(false, "Could not copy data to " + path + ".tmp.dat");
+    }
 
-            auto entry = NewFileEntry(archivePath);
-            entry.offset = offset;
-            entry.size = size;
-            newArchiveFiles.push_back(entry);
-        }
+    try {
+        compressAddedFiles(archiveOut, workerCount, newArchiveFiles);
+    }
+    catch (...) {
+        fclose(archiveOut);
+        throw;
     }
+    RAFenforce(fclose(archiveOut) == 0, "Could not write to " + path + ".tmp.dat");
 
-    for (auto& toAdd : addList) {
-        auto offset = ftell(archiveOut);
-        auto sourcePath = toAdd.second.sourcePath;
-        auto size = compress(sourcePath, archiveOut);
+    writeDirectory(path + ".tmp", newArchiveFiles);
 
-        auto entry = NewFileEntry(toAdd.second.archivePath);
-        entry.offset = offset;
-        entry.size = size;
+    // Because path is reset in dispose
+    auto origPath = path;
+    dispose();
+
+    replaceWith(origPath + ".tmp", origPath);
+    replaceWith(origPath + ".tmp.dat", origPath + ".dat");
+
+    addList.clear();
+    removeList.clear();
+
+    load(origPath);
+}
+
+void RiotArchiveFile::applyAppend(unsigned int workerCount) {
+    auto toRemoveId = getRemovedFiles();
+
+    // Surviving files stay where they are, removed ones are simply no longer pointed at.
+    std::vector<NewFileEntry> newArchiveFiles;
+    for (unsigned int fileIdx = 0; fileIdx < fileListHeader->mCount; fileIdx++) {
+        if (toRemoveId.find(fileIdx) != toRemoveId.end() || !fileListEntries[fileIdx].mSize) {
+            continue;
+        }
+        auto entry = NewFileEntry(getFileName(fileIdx));
+        entry.offset = fileListEntries[fileIdx].mOffset;
+        entry.size = fileListEntries[fileIdx].mSize;
         newArchiveFiles.push_back(entry);
     }
 
+    // The old directory never points past the old end of the .dat file, so until the new directory
+    // replaces it the archive stays valid, just with some unreferenced data at the end.
+    closeArchiveFile();
+    FILE* archiveOut = Platform::openFile(path + ".dat", "r+b");
+    RAFenforce(archiveOut, "Could not open file for appending:" + (path + ".dat"));
+    if (!Platform::seekFile(archiveOut, 0, SEEK_END)) {
+        fclose(archiveOut);
+        RAFenforce(false, "Could not open file for appending:" + (path + ".dat"));
+    }
+    try {
+        compressAddedFiles(archiveOut, workerCount, newArchiveFiles);
+    }
+    catch (...) {
+        fclose(archiveOut);
+        throw;
+    }
+    RAFenforce(fclose(archiveOut) == 0, "Could not write to " + path + ".dat");
+
+    writeDirectory(path + ".tmp", newArchiveFiles);
+
+    auto origPath = path;
+    dispose();
+
+    replaceWith(origPath + ".tmp", origPath);
+
+    addList.clear();
+    removeList.clear();
+
+    load(origPath);
+}
+
+void RiotArchiveFile::writeDirectory(const std::string& outPath, std::vector<NewFileEntry>& newArchiveFiles) const {
     auto sortByHash = [](const NewFileEntry& a, const NewFileEntry& b) {
         if (a.hash < b.hash) { return true; }
         else if (a.hash == b.hash) { return a.archivePath < b.archivePath; }
@@ -430,23 +911,8 @@ void RiotArchiveFile::apply() {
     };
     std::sort(newArchiveFiles.begin(), newArchiveFiles.end(), sortByHash);
 
-
-    // Now make directory file!
-
-    auto exists = [](const std::string& path) {
-        auto attribs = GetFileAttributes(path.c_str());
-        return attribs != INVALID_FILE_ATTRIBUTES;
-    };
-    auto remove = [](const std::string& path) {
-        DeleteFileA(path.c_str());
-    };
-    auto rename = [&](const std::string& from, const std::string& to) {
-        RAFenforce(exists(from), "Cant rename file, does not exist: " + from);
-        RAFenforce(MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING), "Could not rename file " + from + " to " + to);
-    };
-
-    FILE* outFile = nullptr;
-    fopen_s(&outFile, (path + ".tmp").c_str(), "wb");
+    FILE* outFile = Platform::openFile(outPath, "wb");
+    RAFenforce(outFile, "Could not create file:" + outPath);
     fwrite(header, sizeof(*header), 1, outFile);
 
     // Later fseek to sizeof(RAF::Header_t) and write real TOC
@@ -455,10 +921,10 @@ void RiotArchiveFile::apply() {
     auto disc = std::string("RAF File created by RAF Packer for Total Commander");
     fwrite(disc.c_str(), 1, disc.size(), outFile);
 
-    auto fileHeaderOffset = ftell(outFile);
+    auto fileHeaderOffset = Platform::tellFile(outFile);
 
     RAF::FileListHeader_t flHeader;
-    flHeader.mCount = (unsigned long) newArchiveFiles.size();
+    flHeader.mCount = (unsigned int) newArchiveFiles.size();
     fwrite(&flHeader, sizeof(flHeader), 1, outFile);
 
     for (unsigned int fileIdx = 0; fileIdx < newArchiveFiles.size(); fileIdx++) {
@@ -473,7 +939,7 @@ void RiotArchiveFile::apply() {
         fwrite(&entry, sizeof(entry), 1, outFile);
     }
 
-    auto stringListOffset = ftell(outFile);
+    auto stringListOffset = Platform::tellFile(outFile);
     StringTable::HEADER slHeader;
     slHeader.m_Size = 0;
     slHeader.m_Count = (unsigned int) newArchiveFiles.size();
@@ -493,33 +959,17 @@ void RiotArchiveFile::apply() {
     }
 
     slHeader.m_Size = (unsigned int) totalSize;
-    fseek(outFile, stringListOffset, SEEK_SET);
+    Platform::seekFile(outFile, stringListOffset);
     fwrite(&slHeader, sizeof(slHeader), 1, outFile);
 
-    fseek(outFile, sizeof(RAF::Header_t), SEEK_SET);
+    Platform::seekFile(outFile, sizeof(RAF::Header_t));
     RAF::TableOfContents_t newToc;
     newToc.mMgrIndex = 0;
-    newToc.mFileListOffset = fileHeaderOffset;
-    newToc.mStringTableOffset = stringListOffset;
+    newToc.mFileListOffset = (unsigned int)fileHeaderOffset;
+    newToc.mStringTableOffset = (unsigned int)stringListOffset;
     fwrite(&newToc, sizeof(newToc), 1, outFile);
 
-    fclose(archiveOut);
-    fclose(outFile);
-
-    // Because path is reset in dispose
-    auto origPath = path;
-    dispose();
-
-    //rename(origPath, origPath + ".old");
-    //rename(origPath + ".dat", origPath + ".old.dat");
-
-    rename(origPath +".tmp", origPath);
-    rename(origPath +".tmp.dat", origPath + ".dat");
-
-    addList.clear();
-    removeList.clear();
-
-    load(origPath);
+    RAFenforce(fclose(outFile) == 0, "Could not write " + outPath);
 }
 
 
@@ -537,52 +987,139 @@ void RiotArchiveFile::apply() {
 RiotArchiveFileCollection::RiotArchiveFileCollection(bool buildIndex) : buildIndex(buildIndex) {
 }
 
+RiotArchiveFileCollection::~RiotArchiveFileCollection() {
+    dispose();
+}
+
 
 void RiotArchiveFileCollection::dispose() {
-    for (auto archive : archives) {
-        archive->dispose();
-        delete archive;
+    for (const auto& slot : archives) {
+        if (auto archive = slot.load()) {
+            archive->dispose();
+            delete archive;
+        }
     }
     archives.clear();
     archivesNamed.clear();
+    archiveFileOffsets.clear();
+    archiveFileCounts.clear();
+    archivePaths.clear();
+    index.clear();
+    indexFile.reset();
+    if (cache) {
+        cache->clear();
+    }
+}
+
+std::string RiotArchiveFileCollection::indexKey(const std::string& path) {
+    auto key = sanitize(path);
+    std::transform(key.begin(), key.end(), key.begin(), [](char ch) { return (char)tolower(ch); });
+    return key;
+}
+
+RiotArchiveFile* RiotArchiveFileCollection::getArchive(size_t archiveIdx) const {
+    auto& slot = archives[archiveIdx];
+    auto archive = slot.load(std::memory_order_acquire);
+    if (archive) {
+        return archive;
+    }
+    std::lock_guard<std::mutex> lock(archivesMutex);
+    archive = slot.load(std::memory_order_relaxed);
+    if (!archive) {
+        const auto& path = archivePaths[archiveIdx];
+        std::unique_ptr<RiotArchiveFile> opened(new RiotArchiveFile(path));
+        RAFenforce(opened->getFileCount() == archiveFileCounts[archiveIdx], "Archive does not match index: " + path);
+        for (const auto& codec : archiveCodecs) {
+            opened->addCodec(codec);
+        }
+        archive = opened.release();
+        archivesNamed[path] = archive;
+        slot.store(archive, std::memory_order_release);
+    }
+    return archive;
+}
+
+void RiotArchiveFileCollection::indexArchive(size_t archiveIdx) {
+    auto archive = getArchive(archiveIdx);
+    auto fileCount = archive->getFileCount();
+    index.reserve(index.size() + fileCount);
+    for (size_t fileIdx = 0; fileIdx < fileCount; fileIdx++) {
+        IndexEntry entry = { archiveIdx, fileIdx };
+        index[indexKey(archive->getFileName(fileIdx))] = entry;
+    }
+}
+
+void RiotArchiveFileCollection::rebuildIndex() {
+    archiveFileOffsets.clear();
+    archiveFileCounts.clear();
+    index.clear();
+    indexFile.reset();
+    size_t count = 0;
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        if (cache) {
+            cache->invalidate(getArchive(archiveIdx));
+        }
+        archiveFileOffsets.push_back(count);
+        archiveFileCounts.push_back(getArchive(archiveIdx)->getFileCount());
+        count += archiveFileCounts.back();
+        if (buildIndex) {
+            indexArchive(archiveIdx);
+        }
+    }
+}
+
+void RiotArchiveFileCollection::openArchiveFile() const {
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        getArchive(archiveIdx)->openArchiveFile();
+    }
 }
 
 void RiotArchiveFileCollection::closeArchiveFile() const {
     std::cout << "Unmapping " << archives.size() << " archives" << std::endl;
-    for (auto archive : archives) {
-        archive->closeArchiveFile();
+    std::lock_guard<std::mutex> lock(archivesMutex);
+    for (const auto& slot : archives) {
+        if (auto archive = slot.load()) {
+            archive->closeArchiveFile();
+        }
     }
 }
 
 size_t RiotArchiveFileCollection::getFileCount() const {
-    size_t counter = 0;
-    for (auto archive : archives) {
-        counter += archive->getFileCount();
-    }
-    return counter;
+    return archives.empty() ? 0 : archiveFileOffsets.back() + archiveFileCounts.back();
 }
 size_t RiotArchiveFileCollection::getStringCount() const {
     size_t counter = 0;
-    for (auto archive : archives) {
-        counter += archive->getStringCount();
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        counter += getArchive(archiveIdx)->getStringCount();
     }
     return counter;
 };
 
-std::string RiotArchiveFileCollection::getFileName(size_t fileIdx) const {
-    for (auto archive : archives) {
-        auto fileCount = archive->getFileCount();
-        if (fileIdx >= fileCount) {
-            fileIdx -= fileCount;
-            continue;
+size_t RiotArchiveFileCollection::archiveIndexForFile(size_t& fileIdx, const char* caller) const {
+    if (!archives.empty()) {
+        auto it = std::upper_bound(archiveFileOffsets.begin(), archiveFileOffsets.end(), fileIdx) - 1;
+        auto archiveIdx = size_t(it - archiveFileOffsets.begin());
+        auto localIdx = fileIdx - *it;
+        if (localIdx < archiveFileCounts[archiveIdx]) {
+            fileIdx = localIdx;
+            return archiveIdx;
         }
-        return archive->getFileName(fileIdx);
     }
-    throw RiotArchiveFileException("RiotArchiveFileCollection::getFileName bad fileIdx");
+    throw RiotArchiveFileException(std::string("RiotArchiveFileCollection::") + caller + " bad fileIdx");
+}
+
+RiotArchiveFile* RiotArchiveFileCollection::archiveForFile(size_t& fileIdx, const char* caller) const {
+    return getArchive(archiveIndexForFile(fileIdx, caller));
+}
+
+std::string RiotArchiveFileCollection::getFileName(size_t fileIdx) const {
+    auto archive = archiveForFile(fileIdx, "getFileName");
+    return archive->getFileName(fileIdx);
 }
 
 std::string RiotArchiveFileCollection::getString(size_t stringIdx) const {
-    for (auto archive : archives) {
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        auto archive = getArchive(archiveIdx);
         auto stringCount = archive->getStringCount();;
         if (stringIdx >= stringCount) {
             stringIdx -= stringCount;
@@ -594,8 +1131,15 @@ std::string RiotArchiveFileCollection::getString(size_t stringIdx) const {
 }
 
 bool RiotArchiveFileCollection::hasFile(const std::string& path) const {
-    for (auto archive : archives) {
-        if (archive->hasFile(path)) {
+    if (indexFile) {
+        IndexEntry entry;
+        return findInIndexFile(indexKey(path), entry);
+    }
+    if (buildIndex) {
+        return index.find(indexKey(path)) != index.end();
+    }
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        if (getArchive(archiveIdx)->hasFile(path)) {
             return true;
         }
     }
@@ -603,8 +1147,23 @@ bool RiotArchiveFileCollection::hasFile(const std::string& path) const {
 }
 
 size_t RiotArchiveFileCollection::getFileIndex(const std::string& path) const {
+    if (indexFile) {
+        IndexEntry entry;
+        if (!findInIndexFile(indexKey(path), entry)) {
+            throw RiotArchiveFileException("RiotArchiveFileCollection: Could not find file in archive: " + path);
+        }
+        return archiveFileOffsets[entry.archiveIdx] + entry.fileIdx;
+    }
+    if (buildIndex) {
+        auto it = index.find(indexKey(path));
+        if (it == index.end()) {
+            throw RiotArchiveFileException("RiotArchiveFileCollection: Could not find file in archive: " + path);
+        }
+        return archiveFileOffsets[it->second.archiveIdx] + it->second.fileIdx;
+    }
     size_t count = 0;
-    for (auto archive : archives) {
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        auto archive = getArchive(archiveIdx);
         size_t fileCount = archive->getFileCount();
         if (archive->hasFile(path)) {
             return count + archive->getFileIndex(path);
@@ -616,40 +1175,122 @@ size_t RiotArchiveFileCollection::getFileIndex(const std::string& path) const {
     throw RiotArchiveFileException("RiotArchiveFileCollection: Could not find file in archive: " + path);
 }
 
+size_t RiotArchiveFileCollection::getFileSize(size_t fileIdx) const {
+    auto archiveIdx = archiveIndexForFile(fileIdx, "getFileSize");
+    size_t offset, size;
+    if (indexFile && findInIndexFile(archiveIdx, fileIdx, offset, size)) {
+        return size;
+    }
+    return getArchive(archiveIdx)->getFileSize(fileIdx);
+}
+
+size_t RiotArchiveFileCollection::getFileOffset(size_t fileIdx) const {
+    auto archiveIdx = archiveIndexForFile(fileIdx, "getFileOffset");
+    size_t offset, size;
+    if (indexFile && findInIndexFile(archiveIdx, fileIdx, offset, size)) {
+        return offset;
+    }
+    return getArchive(archiveIdx)->getFileOffset(fileIdx);
+}
+
 std::vector<char> RiotArchiveFileCollection::getFileContents(size_t fileIdx) const {
-    for (auto archive : archives) {
-        auto fileCount = archive->getFileCount();
-        if (fileIdx >= fileCount) {
-            fileIdx -= fileCount;
-            continue;
-        }
-        return archive->getFileContents(fileIdx);;
+    if (cache) {
+        return *getSharedFileContents(fileIdx);
     }
-    throw RiotArchiveFileException("RiotArchiveFileCollection::getFileContents bad fileIdx");
+    auto archive = archiveForFile(fileIdx, "getFileContents");
+    return archive->getFileContents(fileIdx);
 }
 
-void RiotArchiveFileCollection::extractFile(size_t fileIdx, const std::string& outPath) const {
-    for (auto archive : archives) {
-        auto fileCount = archive->getFileCount();
-        if (fileIdx >= fileCount) {
-            fileIdx -= fileCount;
-            continue;
-        }
-        archive->extractFile(fileIdx, outPath);
-        return;
+RiotArchiveCache::Buffer RiotArchiveFileCollection::getSharedFileContents(size_t fileIdx) const {
+    auto archive = archiveForFile(fileIdx, "getSharedFileContents");
+    if (!cache) {
+        return std::make_shared<const std::vector<char>>(archive->getFileContents(fileIdx));
     }
-    throw RiotArchiveFileException("RiotArchiveFileCollection::extractFile bad fileIdx");
+    auto generation = archive->getGeneration();
+    auto buffer = cache->find(archive, generation, fileIdx);
+    if (!buffer) {
+        // Decompressed outside of any lock, two threads missing at once both do the work.
+        buffer = std::make_shared<const std::vector<char>>(archive->getFileContents(fileIdx));
+        cache->insert(archive, generation, fileIdx, buffer);
+    }
+    return buffer;
+}
+
+void RiotArchiveFileCollection::enableCache(size_t byteBudget, unsigned int shardCount) {
+    cache.reset(new RiotArchiveCache(byteBudget, shardCount));
+}
+
+void RiotArchiveFileCollection::disableCache() {
+    cache.reset();
+}
+
+size_t RiotArchiveFileCollection::getFileContentsSize(size_t fileIdx) const {
+    auto archive = archiveForFile(fileIdx, "getFileContentsSize");
+    return archive->getFileContentsSize(fileIdx);
+}
+
+size_t RiotArchiveFileCollection::getFileContents(size_t fileIdx, void* buffer, size_t bufferSize) const {
+    auto archive = archiveForFile(fileIdx, "getFileContents");
+    return archive->getFileContents(fileIdx, buffer, bufferSize);
+}
+
+RAFEncoding RiotArchiveFileCollection::getFileEncoding(size_t fileIdx) const {
+    auto archive = archiveForFile(fileIdx, "getFileEncoding");
+    return archive->getFileEncoding(fileIdx);
+}
+
+RiotArchiveFileView RiotArchiveFileCollection::getFileView(size_t fileIdx) const {
+    size_t localIdx = fileIdx;
+    auto archive = archiveForFile(localIdx, "getFileView");
+    if (archive->getFileEncoding(localIdx) == RAFEncoding::stored) {
+        return archive->getFileView(localIdx);
+    }
+    auto contents = getSharedFileContents(fileIdx);
+    return RiotArchiveFileView(contents, contents->data(), contents->size());
+}
+
+void RiotArchiveFileCollection::sortByReadOrder(std::vector<size_t>& fileIdxs) const {
+    struct Key {
+        size_t archiveIdx;
+        size_t offset;
+        size_t fileIdx;
+    };
+    std::vector<Key> keys;
+    keys.reserve(fileIdxs.size());
+    for (auto fileIdx : fileIdxs) {
+        size_t localIdx = fileIdx;
+        Key key;
+        key.archiveIdx = archiveIndexForFile(localIdx, "sortByReadOrder");
+        key.offset = getFileOffset(fileIdx);
+        key.fileIdx = fileIdx;
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) {
+        return a.archiveIdx != b.archiveIdx ? a.archiveIdx < b.archiveIdx : a.offset < b.offset;
+    });
+    for (size_t idx = 0; idx < keys.size(); idx++) {
+        fileIdxs[idx] = keys[idx].fileIdx;
+    }
+}
+
+void RiotArchiveFileCollection::prefetch(size_t fileIdx) const {
+    auto archive = archiveForFile(fileIdx, "prefetch");
+    archive->prefetch(fileIdx);
+}
+
+void RiotArchiveFileCollection::extractFile(size_t fileIdx, const std::string& outPath) const {
+    auto archive = archiveForFile(fileIdx, "extractFile");
+    archive->extractFile(fileIdx, outPath);
 }
 
 void RiotArchiveFileCollection::unpackArchive(const std::string& outPath) const {
     auto totalFiles = getFileCount();
     for (ptrdiff_t fileIdx = totalFiles-1; fileIdx >= 0; fileIdx--) {
         auto fileName = getFileName(fileIdx);
-        auto outFilePath = outPath + "\\" + fileName;
+        auto outFilePath = outPath + Platform::PathSeparator + fileName;
         try {
             makePath(outFilePath, true);
-            auto attribs = GetFileAttributes(outFilePath.c_str());
-            if (attribs == INVALID_FILE_ATTRIBUTES) {
+            if (!Platform::fileExists(outFilePath)) {
                 extractFile(fileIdx, outFilePath);
             }
         }
@@ -667,12 +1308,305 @@ void RiotArchiveFileCollection::unpackArchive(const std::string& outPath) const
 
 }
 
+void RiotArchiveFileCollection::addCodec(std::shared_ptr<const RiotCodec> codec) {
+    RAFenforce(codec, "No codec given to addCodec");
+    std::lock_guard<std::mutex> lock(archivesMutex);
+    archiveCodecs.push_back(codec);
+    for (const auto& slot : archives) {
+        if (auto archive = slot.load()) {
+            archive->addCodec(codec);
+        }
+    }
+}
+
 void RiotArchiveFileCollection::addArchive(const std::string& path) {
+    RAFenforce(!indexFile, "RiotArchiveFileCollection::addArchive after loadIndex, rebuildIndex first");
     if (archivesNamed.find(path) != archivesNamed.end()) {
         return;
     }
     auto archive = new RiotArchiveFile(path);
-    archives.push_back(archive);
+    for (const auto& codec : archiveCodecs) {
+        archive->addCodec(codec);
+    }
+    archiveFileOffsets.push_back(archives.empty() ? 0 : archiveFileOffsets.back() + archiveFileCounts.back());
+    archiveFileCounts.push_back(archive->getFileCount());
+    archivePaths.push_back(path);
+    archives.emplace_back(archive);
     archivesNamed[path] = archive;
+    if (buildIndex) {
+        indexArchive(archives.size() - 1);
+    }
+}
+
+void RiotArchiveFileCollection::unpackArchiveParallel(const std::string& outPath, unsigned int workerCount) const {
+    // Same rules as unpackArchive: newer archives win and files already on disk are left alone.
+    std::vector<size_t> fileIdxs;
+    std::vector<std::string> outPaths;
+    std::set<std::string> seen;
+    auto totalFiles = getFileCount();
+    for (ptrdiff_t fileIdx = totalFiles - 1; fileIdx >= 0; fileIdx--) {
+        auto fileName = getFileName(fileIdx);
+        if (!seen.insert(indexKey(fileName)).second) {
+            continue;
+        }
+        auto outFilePath = outPath + Platform::PathSeparator + fileName;
+        if (Platform::fileExists(outFilePath)) {
+            continue;
+        }
+        fileIdxs.push_back(fileIdx);
+        outPaths.push_back(outFilePath);
+    }
+    extractFilesParallel(fileIdxs, outPaths, workerCount);
 }
 
+
+// Layout of the file written by saveIndex. Native endianness, it is a cache and not meant to travel.
+namespace RAFIndex
+{
+    enum {
+        MagicNumber = 0x58444952, // RIDX
+        Version = 2,
+        EmptyBucket = 0xFFFFFFFF,
+    };
+
+    struct Header_t {
+        unsigned int mMagic;
+        unsigned int mVersion;
+        unsigned int mArchiveCount;
+        unsigned int mEntryCount;
+        // Power of two, open addressing with linear probing. Buckets hold entry indices.
+        unsigned int mBucketCount;
+        unsigned int mStringTableSize;
+        unsigned int mArchiveTableOffset;
+        unsigned int mEntryTableOffset;
+        unsigned int mBucketTableOffset;
+        unsigned int mStringTableOffset;
+    };
+
+    struct Archive_t {
+        unsigned int mPathOffset;
+        unsigned int mFileCount;
+        unsigned long long mDirectorySize;
+        unsigned long long mDirectoryTime;
+        unsigned long long mDataSize;
+        unsigned long long mDataTime;
+    };
+
+    // Sorted by archive and file index, so offsets and sizes can be looked up by file too.
+    struct Entry_t {
+        // RiotArchiveFile::hashString of the lowercased path.
+        unsigned int mHash;
+        unsigned int mPathOffset;
+        unsigned int mArchiveIdx;
+        unsigned int mFileIdx;
+        unsigned int mOffset;
+        unsigned int mSize;
+    };
+
+    bool getArchiveStats(const std::string& path, Archive_t& archive) {
+        if (!Platform::getFileSize(path, archive.mDirectorySize) || !Platform::getFileTime(path, archive.mDirectoryTime)) {
+            return false;
+        }
+        // Empty archives might not have a .dat at all.
+        archive.mDataSize = archive.mDataTime = 0;
+        if (Platform::getFileSize(path + ".dat", archive.mDataSize)) {
+            return Platform::getFileTime(path + ".dat", archive.mDataTime);
+        }
+        return true;
+    }
+}
+
+void RiotArchiveFileCollection::saveIndex(const std::string& indexPath) const {
+    // Resolve overrides the same way the index map does, later archives win.
+    std::unordered_map<std::string, IndexEntry> merged;
+    if (buildIndex && !indexFile) {
+        merged = index;
+    }
+    else {
+        for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+            auto archive = getArchive(archiveIdx);
+            for (size_t fileIdx = 0; fileIdx < archive->getFileCount(); fileIdx++) {
+                IndexEntry entry = { archiveIdx, fileIdx };
+                merged[indexKey(archive->getFileName(fileIdx))] = entry;
+            }
+        }
+    }
+    std::vector<std::pair<std::string, IndexEntry>> sorted(merged.begin(), merged.end());
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, IndexEntry>& a, const std::pair<std::string, IndexEntry>& b) {
+        return a.second.archiveIdx != b.second.archiveIdx ? a.second.archiveIdx < b.second.archiveIdx : a.second.fileIdx < b.second.fileIdx;
+    });
+
+    std::vector<char> strings;
+    auto addString = [&](const std::string& str) {
+        auto offset = (unsigned int)strings.size();
+        strings.insert(strings.end(), str.begin(), str.end());
+        strings.push_back('\0');
+        return offset;
+    };
+
+    std::vector<RAFIndex::Archive_t> archiveTable;
+    for (size_t archiveIdx = 0; archiveIdx < archives.size(); archiveIdx++) {
+        auto archive = getArchive(archiveIdx);
+        RAFIndex::Archive_t info;
+        RAFenforce(RAFIndex::getArchiveStats(archive->getPath(), info), "Could not read file attributes of archive " + archive->getPath());
+        info.mPathOffset = addString(archive->getPath());
+        info.mFileCount = (unsigned int)archive->getFileCount();
+        archiveTable.push_back(info);
+    }
+
+    unsigned int bucketCount = 16;
+    while (bucketCount < merged.size() * 2) {
+        bucketCount *= 2;
+    }
+    std::vector<RAFIndex::Entry_t> entryTable;
+    std::vector<unsigned int> bucketTable(bucketCount, (unsigned int)RAFIndex::EmptyBucket);
+    entryTable.reserve(sorted.size());
+    for (const auto& it : sorted) {
+        auto archive = getArchive(it.second.archiveIdx);
+        RAFIndex::Entry_t entry;
+        entry.mHash = hashString(it.first);
+        entry.mPathOffset = addString(it.first);
+        entry.mArchiveIdx = (unsigned int)it.second.archiveIdx;
+        entry.mFileIdx = (unsigned int)it.second.fileIdx;
+        entry.mOffset = (unsigned int)archive->getFileOffset(it.second.fileIdx);
+        entry.mSize = (unsigned int)archive->getFileSize(it.second.fileIdx);
+
+        auto bucket = entry.mHash & (bucketCount - 1);
+        while (bucketTable[bucket] != RAFIndex::EmptyBucket) {
+            bucket = (bucket + 1) & (bucketCount - 1);
+        }
+        bucketTable[bucket] = (unsigned int)entryTable.size();
+        entryTable.push_back(entry);
+    }
+
+    RAFIndex::Header_t header;
+    header.mMagic = RAFIndex::MagicNumber;
+    header.mVersion = RAFIndex::Version;
+    header.mArchiveCount = (unsigned int)archiveTable.size();
+    header.mEntryCount = (unsigned int)entryTable.size();
+    header.mBucketCount = bucketCount;
+    header.mStringTableSize = (unsigned int)strings.size();
+    header.mArchiveTableOffset = sizeof(header);
+    header.mEntryTableOffset = header.mArchiveTableOffset + (unsigned int)(archiveTable.size() * sizeof(RAFIndex::Archive_t));
+    header.mBucketTableOffset = header.mEntryTableOffset + (unsigned int)(entryTable.size() * sizeof(RAFIndex::Entry_t));
+    header.mStringTableOffset = header.mBucketTableOffset + bucketCount * sizeof(unsigned int);
+
+    // Written next to the target and renamed over it, so a reader never sees half a file.
+    auto tmpPath = indexPath + ".tmp";
+    FILE* outFile = Platform::openFile(tmpPath, "wb");
+    RAFenforce(outFile, "Could not create file:" + tmpPath);
+    fwrite(&header, sizeof(header), 1, outFile);
+    fwrite(archiveTable.data(), sizeof(RAFIndex::Archive_t), archiveTable.size(), outFile);
+    fwrite(entryTable.data(), sizeof(RAFIndex::Entry_t), entryTable.size(), outFile);
+    fwrite(bucketTable.data(), sizeof(unsigned int), bucketTable.size(), outFile);
+    fwrite(strings.data(), 1, strings.size(), outFile);
+    auto writeFailed = ferror(outFile);
+    fclose(outFile);
+    RAFenforce(!writeFailed, "Could not write file:" + tmpPath);
+    RAFenforce(Platform::replaceFile(tmpPath, indexPath), "Could not rename file " + tmpPath + " to " + indexPath);
+}
+
+bool RiotArchiveFileCollection::loadIndex(const std::string& indexPath) {
+    RAFenforce(archives.empty(), "RiotArchiveFileCollection::loadIndex needs an empty collection");
+
+    unsigned long long fileSize;
+    if (!Platform::getFileSize(indexPath, fileSize) || fileSize < sizeof(RAFIndex::Header_t)) {
+        return false;
+    }
+    std::unique_ptr<MMFile> mapped;
+    mapped.reset(new MMFile(indexPath, MMOpenMode::read, 0, MMAccessHint::willNeed));
+    auto base = (const char*)mapped->getPtr();
+    auto header = (const RAFIndex::Header_t*)base;
+
+    // Only the table bounds are checked, nothing is parsed.
+    auto fits = [&](unsigned long long offset, unsigned long long size) {
+        return offset + size <= fileSize;
+    };
+    if (header->mMagic != RAFIndex::MagicNumber || header->mVersion != RAFIndex::Version ||
+        !header->mBucketCount || (header->mBucketCount & (header->mBucketCount - 1)) ||
+        header->mEntryCount >= header->mBucketCount ||
+        header->mArchiveTableOffset % sizeof(unsigned long long) || header->mEntryTableOffset % sizeof(unsigned int) ||
+        header->mBucketTableOffset % sizeof(unsigned int) ||
+        !fits(header->mArchiveTableOffset, (unsigned long long)header->mArchiveCount * sizeof(RAFIndex::Archive_t)) ||
+        !fits(header->mEntryTableOffset, (unsigned long long)header->mEntryCount * sizeof(RAFIndex::Entry_t)) ||
+        !fits(header->mBucketTableOffset, (unsigned long long)header->mBucketCount * sizeof(unsigned int)) ||
+        !fits(header->mStringTableOffset, header->mStringTableSize) ||
+        !header->mStringTableSize || base[header->mStringTableOffset + header->mStringTableSize - 1] != '\0') {
+        return false;
+    }
+
+    auto archiveTable = (const RAFIndex::Archive_t*)(base + header->mArchiveTableOffset);
+    auto strings = base + header->mStringTableOffset;
+    for (unsigned int archiveIdx = 0; archiveIdx < header->mArchiveCount; archiveIdx++) {
+        const auto& expected = archiveTable[archiveIdx];
+        RAFIndex::Archive_t current;
+        if (expected.mPathOffset >= header->mStringTableSize ||
+            !RAFIndex::getArchiveStats(strings + expected.mPathOffset, current) ||
+            current.mDirectorySize != expected.mDirectorySize || current.mDirectoryTime != expected.mDirectoryTime ||
+            current.mDataSize != expected.mDataSize || current.mDataTime != expected.mDataTime) {
+            return false;
+        }
+    }
+
+    // Nothing is opened here, getArchive does that on first use.
+    indexFile = std::move(mapped);
+    size_t count = 0;
+    for (unsigned int archiveIdx = 0; archiveIdx < header->mArchiveCount; archiveIdx++) {
+        std::string path = strings + archiveTable[archiveIdx].mPathOffset;
+        archiveFileOffsets.push_back(count);
+        archiveFileCounts.push_back(archiveTable[archiveIdx].mFileCount);
+        archivePaths.push_back(path);
+        archives.emplace_back(nullptr);
+        archivesNamed[path] = nullptr;
+        count += archiveTable[archiveIdx].mFileCount;
+    }
+    return true;
+}
+
+bool RiotArchiveFileCollection::findInIndexFile(const std::string& key, IndexEntry& entry) const {
+    auto base = (const char*)indexFile->getPtr();
+    auto header = (const RAFIndex::Header_t*)base;
+    auto entries = (const RAFIndex::Entry_t*)(base + header->mEntryTableOffset);
+    auto buckets = (const unsigned int*)(base + header->mBucketTableOffset);
+    auto strings = base + header->mStringTableOffset;
+
+    auto hash = hashString(key);
+    auto mask = header->mBucketCount - 1;
+    // A broken file might have no empty bucket to stop at.
+    auto bucket = hash & mask;
+    for (unsigned int probe = 0; probe < header->mBucketCount; probe++, bucket = (bucket + 1) & mask) {
+        auto entryIdx = buckets[bucket];
+        if (entryIdx == RAFIndex::EmptyBucket || entryIdx >= header->mEntryCount) {
+            return false;
+        }
+        const auto& found = entries[entryIdx];
+        if (found.mHash == hash && found.mPathOffset < header->mStringTableSize && key == strings + found.mPathOffset) {
+            RAFenforce(found.mArchiveIdx < archives.size() && found.mFileIdx < archiveFileCounts[found.mArchiveIdx], "Bad file index in index file");
+            entry.archiveIdx = found.mArchiveIdx;
+            entry.fileIdx = found.mFileIdx;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RiotArchiveFileCollection::findInIndexFile(size_t archiveIdx, size_t fileIdx, size_t& offset, size_t& size) const {
+    auto base = (const char*)indexFile->getPtr();
+    auto header = (const RAFIndex::Header_t*)base;
+    auto entries = (const RAFIndex::Entry_t*)(base + header->mEntryTableOffset);
+    auto entriesEnd = entries + header->mEntryCount;
+
+    RAFIndex::Entry_t key;
+    key.mArchiveIdx = (unsigned int)archiveIdx;
+    key.mFileIdx = (unsigned int)fileIdx;
+    auto found = std::lower_bound(entries, entriesEnd, key, [](const RAFIndex::Entry_t& a, const RAFIndex::Entry_t& b) {
+        return a.mArchiveIdx != b.mArchiveIdx ? a.mArchiveIdx < b.mArchiveIdx : a.mFileIdx < b.mFileIdx;
+    });
+    // Files shadowed by a later archive have no entry.
+    if (found == entriesEnd || found->mArchiveIdx != archiveIdx || found->mFileIdx != fileIdx) {
+        return false;
+    }
+    offset = found->mOffset;
+    size = found->mSize;
+    return true;
+}
@@ -0,0 +1,317 @@
+#include "RiotFiles/RiotCodec.h"
+#include "RiotFiles/RiotArchiveFile.h"
+#include "RiotFiles/MMFile.h"
+
+#include "zlib/zlib.h"
+#include "zstd/zstd.h"
+#include "zstd/zdict.h"
+#include "lz4/LZ4Frame.h"
+#include <algorithm>
+#include <cstring>
+
+#define STRINGIZE_UGH(X) #X
+#define STRINGIZE(X) STRINGIZE_UGH(X)
+
+#define RAFenforce(cond, msg) if(!(cond)) { throw RiotArchiveFileException(std::string(__FILE__ " " STRINGIZE(__LINE__) ": ") + (msg)); }
+
+static std::string getZLibError(int error) {
+    switch (error) {
+    case Z_OK: return "Z_OK: No error";
+    case Z_STREAM_END: return "Z_STREAM_END: The stream ended";
+    case Z_NEED_DICT: return "Z_NEED_DICT: Needs a dictionary";
+    case Z_ERRNO: return "Z_ERRNO: No idea";
+    case Z_STREAM_ERROR: return "Z_STREAM_ERROR: No idea";
+    case Z_DATA_ERROR: return "Z_DATA_ERROR: No idea";
+    case Z_MEM_ERROR: return "Z_MEM_ERROR: No idea";
+    case Z_BUF_ERROR: return "Z_BUF_ERROR: Check you're z_stream!";
+    case Z_VERSION_ERROR: return "Z_VERSION_ERROR: Mismatching version!";
+    default: return "Unrecognized ZLib-error";
+    }
+}
+
+// Little endian, which is how both zstd and lz4 write their magic numbers.
+static bool hasMagic(const void* data, size_t size, unsigned int magic) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    return size >= 4 && (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24)) == magic;
+}
+
+// For codecs that know the decompressed size up front: decode(target) fills all of contentSize
+// bytes, straight into the caller's buffer when it is big enough.
+template <typename Decode>
+static size_t decodeWhole(size_t contentSize, char* buffer, size_t bufferSize, std::vector<char>* growBuffer, const Decode& decode) {
+    if (growBuffer) {
+        growBuffer->resize(contentSize);
+        decode(growBuffer->data());
+    }
+    else if (bufferSize >= contentSize) {
+        decode(buffer);
+    }
+    else if (bufferSize) {
+        std::vector<char> whole(contentSize);
+        decode(whole.data());
+        memcpy(buffer, whole.data(), bufferSize);
+    }
+    return contentSize;
+}
+
+
+class StoredCodec : public RiotCodec
+{
+public:
+    virtual RAFEncoding getEncoding() const override {
+        return RAFEncoding::stored;
+    }
+    virtual bool isEncoded(const void*, size_t) const override {
+        return false;
+    }
+    virtual void compress(const void* data, size_t size, std::vector<char>& out) const override {
+        out.assign((const char*)data, (const char*)data + size);
+    }
+    virtual size_t decompress(const void*, size_t, char*, size_t, std::vector<char>*) const override {
+        return NotEncoded;
+    }
+};
+
+
+class ZLibCodec : public RiotCodec
+{
+    int level;
+public:
+    ZLibCodec(int level) : level(level) {}
+
+    virtual RAFEncoding getEncoding() const override {
+        return RAFEncoding::zlib;
+    }
+
+    // Checks for a zlib header: deflate with at most a 32K window, no preset dictionary, and the
+    // check bits right. Preset dictionaries are not something RAF files use.
+    virtual bool isEncoded(const void* data, size_t size) const override {
+        if (size < 2) {
+            return false;
+        }
+        unsigned int cmf = ((const unsigned char*)data)[0];
+        unsigned int flg = ((const unsigned char*)data)[1];
+        return (cmf & 0x0f) == Z_DEFLATED && (cmf >> 4) <= 7 && (flg & 0x20) == 0 && ((cmf << 8) | flg) % 31 == 0;
+    }
+
+    virtual void compress(const void* data, size_t size, std::vector<char>& out) const override {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        deflateInit(&stream, level);
+
+        // deflateBound is enough to finish in one go.
+        out.resize(deflateBound(&stream, (uLong)size));
+        stream.avail_in = (unsigned int)size;
+        stream.next_in = (Bytef*)data;
+        stream.avail_out = (unsigned int)out.size();
+        stream.next_out = (Bytef*)out.data();
+        auto err = deflate(&stream, Z_FINISH);
+        deflateEnd(&stream);
+        RAFenforce(err == Z_STREAM_END, "Error in deflate: " + getZLibError(err));
+        out.resize(out.size() - stream.avail_out);
+    }
+
+    virtual size_t decompress(const void* data, size_t size, char* buffer, size_t bufferSize, std::vector<char>* growBuffer) const override {
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        inflateInit(&stream);
+
+        stream.avail_in = (uInt)size;
+        stream.next_in = (Bytef*)data;
+
+        // Output that does not fit in the buffer ends up here, only to be counted.
+        Bytef scratch[4096];
+
+        size_t total = 0;
+        bool doneAny = false;
+        int err;
+        do {
+            if (growBuffer && total == bufferSize) {
+                growBuffer->resize(std::max<size_t>(bufferSize * 2, 4096));
+                buffer = growBuffer->data();
+                bufferSize = growBuffer->size();
+            }
+            uInt available;
+            if (total < bufferSize) {
+                available = (uInt)std::min<size_t>(bufferSize - total, 1 << 30);
+                stream.next_out = (Bytef*)buffer + total;
+            }
+            else {
+                available = sizeof(scratch);
+                stream.next_out = scratch;
+            }
+            stream.avail_out = available;
+            err = inflate(&stream, Z_NO_FLUSH);
+            if (err != Z_OK && err != Z_STREAM_END) {
+                inflateEnd(&stream);
+                // A stored file that only looked like a zlib stream.
+                RAFenforce(!doneAny, "Error in deflate: " + getZLibError(err));
+                return NotEncoded;
+            }
+            total += available - stream.avail_out;
+            doneAny = true;
+        } while (err != Z_STREAM_END && (stream.avail_in || !stream.avail_out));
+        inflateEnd(&stream);
+        // Out of input with room left in the output, the stream was cut short.
+        RAFenforce(err == Z_STREAM_END, "Error in deflate: truncated stream");
+
+        if (growBuffer) {
+            growBuffer->resize(total);
+        }
+        return total;
+    }
+};
+
+
+class ZstdCodec : public RiotCodec
+{
+    int level;
+    // Digested once, shared read-only by every (de)compression.
+    ZSTD_CDict* compressDictionary;
+    ZSTD_DDict* decompressDictionary;
+    unsigned int dictionaryId;
+
+    ZstdCodec(const ZstdCodec&);
+    ZstdCodec& operator=(const ZstdCodec&);
+public:
+    ZstdCodec(int level, const std::vector<char>& dictionary)
+        : level(level), compressDictionary(nullptr), decompressDictionary(nullptr), dictionaryId(0)
+    {
+        if (!dictionary.empty()) {
+            compressDictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+            decompressDictionary = ZSTD_createDDict(dictionary.data(), dictionary.size());
+            if (!compressDictionary || !decompressDictionary) {
+                ZSTD_freeCDict(compressDictionary);
+                ZSTD_freeDDict(decompressDictionary);
+                RAFenforce(false, "Could not load zstd dictionary");
+            }
+            dictionaryId = ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+        }
+    }
+    ~ZstdCodec() {
+        ZSTD_freeCDict(compressDictionary);
+        ZSTD_freeDDict(decompressDictionary);
+    }
+
+    virtual RAFEncoding getEncoding() const override {
+        return RAFEncoding::zstd;
+    }
+    virtual bool isEncoded(const void* data, size_t size) const override {
+        return hasMagic(data, size, ZSTD_MAGICNUMBER);
+    }
+
+    virtual void compress(const void* data, size_t size, std::vector<char>& out) const override {
+        std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        RAFenforce(context, "Could not create zstd context");
+        out.resize(ZSTD_compressBound(size));
+        auto written = compressDictionary ?
+            ZSTD_compress_usingCDict(context.get(), out.data(), out.size(), data, size, compressDictionary) :
+            ZSTD_compressCCtx(context.get(), out.data(), out.size(), data, size, level);
+        RAFenforce(!ZSTD_isError(written), std::string("Error in zstd: ") + ZSTD_getErrorName(written));
+        out.resize(written);
+    }
+
+    virtual size_t decompress(const void* data, size_t size, char* buffer, size_t bufferSize, std::vector<char>* growBuffer) const override {
+        auto contentSize = ZSTD_getFrameContentSize(data, size);
+        if (!isEncoded(data, size) || contentSize == ZSTD_CONTENTSIZE_ERROR) {
+            return NotEncoded;
+        }
+        // compress always records the size; frames from elsewhere might not.
+        RAFenforce(contentSize != ZSTD_CONTENTSIZE_UNKNOWN, "zstd frame without content size");
+        // Frames without a dictionary id decode the same with or without one.
+        auto frameDictionaryId = ZSTD_getDictID_fromFrame(data, size);
+        RAFenforce(!frameDictionaryId || (decompressDictionary && frameDictionaryId == dictionaryId),
+            "zstd frame needs dictionary " + std::to_string(frameDictionaryId));
+        return decodeWhole((size_t)contentSize, buffer, bufferSize, growBuffer, [&](char* target) {
+            std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            RAFenforce(context, "Could not create zstd context");
+            auto read = decompressDictionary ?
+                ZSTD_decompress_usingDDict(context.get(), target, (size_t)contentSize, data, size, decompressDictionary) :
+                ZSTD_decompressDCtx(context.get(), target, (size_t)contentSize, data, size);
+            RAFenforce(!ZSTD_isError(read), std::string("Error in zstd: ") + ZSTD_getErrorName(read));
+            RAFenforce(read == contentSize, "zstd frame shorter than its content size");
+        });
+    }
+};
+
+
+class LZ4Codec : public RiotCodec
+{
+    int level;
+public:
+    LZ4Codec(int level) : level(level) {}
+
+    virtual RAFEncoding getEncoding() const override {
+        return RAFEncoding::lz4;
+    }
+    virtual bool isEncoded(const void* data, size_t size) const override {
+        return hasMagic(data, size, LZ4Frame::MagicNumber);
+    }
+
+    virtual void compress(const void* data, size_t size, std::vector<char>& out) const override {
+        out.resize(LZ4Frame::compressBound(size));
+        out.resize(LZ4Frame::compress(data, size, out.data(), level));
+    }
+
+    virtual size_t decompress(const void* data, size_t size, char* buffer, size_t bufferSize, std::vector<char>* growBuffer) const override {
+        unsigned long long contentSize;
+        bool hasContentSize;
+        if (!LZ4Frame::readHeader(data, size, contentSize, hasContentSize)) {
+            return NotEncoded;
+        }
+        // compress always records the size; frames from elsewhere might not.
+        RAFenforce(hasContentSize, "lz4 frame without content size");
+        return decodeWhole((size_t)contentSize, buffer, bufferSize, growBuffer, [&](char* target) {
+            RAFenforce(LZ4Frame::decompress(data, size, target, (size_t)contentSize), "Error in lz4: broken frame");
+        });
+    }
+};
+
+
+std::shared_ptr<const RiotCodec> RiotCodec::stored() {
+    return std::make_shared<StoredCodec>();
+}
+
+std::shared_ptr<const RiotCodec> RiotCodec::zlib(int level) {
+    return std::make_shared<ZLibCodec>(level);
+}
+
+std::shared_ptr<const RiotCodec> RiotCodec::zstd(int level, const std::vector<char>& dictionary) {
+    return std::make_shared<ZstdCodec>(level, dictionary);
+}
+
+std::shared_ptr<const RiotCodec> RiotCodec::lz4(int level) {
+    return std::make_shared<LZ4Codec>(level);
+}
+
+std::vector<char> RiotCodec::trainZstdDictionary(const std::vector<std::string>& samplePaths, size_t dictionarySize) {
+    std::vector<char> samples;
+    std::vector<size_t> sampleSizes;
+    for (const auto& samplePath : samplePaths) {
+        MMFile sample(samplePath, MMOpenMode::read, 0, MMAccessHint::sequential);
+        auto ptr = (const char*)sample.getPtr();
+        samples.insert(samples.end(), ptr, ptr + sample.getSize());
+        sampleSizes.push_back(sample.getSize());
+    }
+    std::vector<char> dictionary(dictionarySize);
+    auto size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(), sampleSizes.data(), (unsigned int)sampleSizes.size());
+    RAFenforce(!ZDICT_isError(size), std::string("Could not train zstd dictionary: ") + ZDICT_getErrorName(size));
+    dictionary.resize(size);
+    return dictionary;
+}
+
+static std::vector<std::shared_ptr<const RiotCodec>> makeBuiltinCodecs() {
+    // zlib first, it is by far the most common and the cheapest to check.
+    std::vector<std::shared_ptr<const RiotCodec>> codecs;
+    codecs.push_back(RiotCodec::zlib());
+    codecs.push_back(RiotCodec::zstd());
+    codecs.push_back(RiotCodec::lz4());
+    return codecs;
+}
+
+// Made before main rather than on first use, function statics are not thread safe everywhere.
+static const std::vector<std::shared_ptr<const RiotCodec>> builtinCodecs = makeBuiltinCodecs();
+
+const std::vector<std::shared_ptr<const RiotCodec>>& RiotCodec::getBuiltinCodecs() {
+    return builtinCodecs;
+}
@@ -0,0 +1,344 @@
+#include "RiotFiles/RiotCompactAnimation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    enum TrackMode {
+        constantTrack,
+        linearTrack,
+        animatedTrack
+    };
+
+    // Start of the buffer, one per bone. Offsets of constant and linear values are into the buffer,
+    // those of animated values into a frame.
+    struct Track_t {
+        char mName[32];
+        unsigned int mUnknown;
+        unsigned char mRotationMode;
+        unsigned char mPositionMode;
+        unsigned short mPad;
+        unsigned int mRotationOffset;
+        unsigned int mPositionOffset;
+    };
+    static_assert(sizeof(Track_t) == 48, "Track_t keeps the values after it 4 byte aligned");
+
+    const size_t QuantizedRotationSize = 3 * sizeof(unsigned short);
+    const float SqrtHalf = 0.70710678f;
+
+    void normalize(float* q) {
+        float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        if (length > 0) {
+            for (int c = 0; c < 4; c++) {
+                q[c] /= length;
+            }
+        }
+    }
+
+    float dot(const float* a, const float* b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    }
+
+    // Distance between unit quaternions, taking q and -q as the same rotation. Unlike the dot
+    // product this stays precise for tiny angles: it is 2 sin(angle / 4).
+    double distance(const float* a, const float* b) {
+        double same = 0, opposite = 0;
+        for (int c = 0; c < 4; c++) {
+            same += double(a[c] - b[c]) * double(a[c] - b[c]);
+            opposite += double(a[c] + b[c]) * double(a[c] + b[c]);
+        }
+        return std::sqrt(std::min(same, opposite));
+    }
+
+    // Normalized lerp along the short way, a and b unit length.
+    void blendRotation(const float* a, const float* b, float t, float* out) {
+        float sign = dot(a, b) < 0 ? -1.0f : 1.0f;
+        for (int c = 0; c < 4; c++) {
+            out[c] = a[c] + (b[c] * sign - a[c]) * t;
+        }
+        normalize(out);
+    }
+
+    void blendPosition(const float* a, const float* b, float t, float* out) {
+        for (int c = 0; c < 3; c++) {
+            out[c] = a[c] + (b[c] - a[c]) * t;
+        }
+    }
+
+    // Three smallest components in 15 bits each, the index of the largest in the top bits of the
+    // first two. The largest is made positive and recovered as sqrt(1 - the others squared).
+    void quantizeRotation(const float* q, unsigned short* out) {
+        int largest = 0;
+        for (int c = 1; c < 4; c++) {
+            if (std::fabs(q[c]) > std::fabs(q[largest])) {
+                largest = c;
+            }
+        }
+        float sign = q[largest] < 0 ? -1.0f : 1.0f;
+        unsigned short packed[3];
+        for (int c = 0, slot = 0; c < 4; c++) {
+            if (c == largest) {
+                continue;
+            }
+            float unit = (q[c] * sign / SqrtHalf) * 0.5f + 0.5f;
+            long value = std::lrint(unit * 32767.0f);
+            packed[slot++] = (unsigned short)std::max(0L, std::min(32767L, value));
+        }
+        out[0] = (unsigned short)(packed[0] | ((largest & 1) << 15));
+        out[1] = (unsigned short)(packed[1] | ((largest >> 1) << 15));
+        out[2] = packed[2];
+    }
+
+    void dequantizeRotation(const unsigned short* in, float* q) {
+        int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+        float sum = 0;
+        for (int c = 0, slot = 0; c < 4; c++) {
+            if (c == largest) {
+                continue;
+            }
+            float value = ((in[slot++] & 0x7fff) / 32767.0f - 0.5f) * 2.0f * SqrtHalf;
+            q[c] = value;
+            sum += value * value;
+        }
+        q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+    }
+
+    void appendFloats(std::vector<float>& pool, const float* values, size_t count) {
+        pool.insert(pool.end(), values, values + count);
+    }
+}
+
+RiotCompactAnimation::RiotCompactAnimation(const RiotAnimation& animation, const Options& options)
+    : boneCount((unsigned int)animation.bones.size()), frameCount(animation.frameCount), fps(animation.fps),
+      quantized(options.quantizeRotations)
+{
+    std::vector<Track_t> tracks(boneCount);
+    std::vector<float> pool;
+    std::vector<size_t> animatedRotations, animatedPositions;
+
+    // Rotations differ by at most the tolerance when their distance is at most this.
+    double maximumDistance = 2.0 * std::sin(double(options.rotationTolerance) * 0.25);
+    size_t tableBytes = boneCount * sizeof(Track_t);
+
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        const auto& source = animation.bones[bone];
+        ANMenforce(source.frames.size() == frameCount, "Bone with the wrong number of frames in animation");
+        auto& track = tracks[bone];
+        memset(&track, 0, sizeof(track));
+        memcpy(track.mName, source.bone.mName, sizeof(track.mName));
+        track.mUnknown = source.bone.unknown;
+
+        if (frameCount == 0) {
+            const float identity[7] = { 0, 0, 0, 1, 0, 0, 0 };
+            track.mRotationMode = constantTrack;
+            track.mRotationOffset = (unsigned int)(tableBytes + pool.size() * sizeof(float));
+            appendFloats(pool, identity, 4);
+            track.mPositionMode = constantTrack;
+            track.mPositionOffset = (unsigned int)(tableBytes + pool.size() * sizeof(float));
+            appendFloats(pool, identity + 4, 3);
+            continue;
+        }
+
+        float first[4], last[4];
+        memcpy(first, source.frames.front().mOrientation, sizeof(first));
+        memcpy(last, source.frames.back().mOrientation, sizeof(last));
+        normalize(first);
+        normalize(last);
+        bool constant = true, linear = true;
+        for (size_t frame = 0; frame < frameCount && (constant || linear); frame++) {
+            float actual[4], blended[4];
+            memcpy(actual, source.frames[frame].mOrientation, sizeof(actual));
+            normalize(actual);
+            constant = constant && distance(first, actual) <= maximumDistance;
+            float t = frameCount > 1 ? float(frame) / float(frameCount - 1) : 0.0f;
+            blendRotation(first, last, t, blended);
+            linear = linear && distance(blended, actual) <= maximumDistance;
+        }
+        if (constant) {
+            track.mRotationMode = constantTrack;
+            track.mRotationOffset = (unsigned int)(tableBytes + pool.size() * sizeof(float));
+            appendFloats(pool, first, 4);
+        }
+        else if (linear) {
+            track.mRotationMode = linearTrack;
+            track.mRotationOffset = (unsigned int)(tableBytes + pool.size() * sizeof(float));
+            appendFloats(pool, first, 4);
+            appendFloats(pool, last, 4);
+        }
+        else {
+            track.mRotationMode = animatedTrack;
+            animatedRotations.push_back(bone);
+        }
+
+        const float* firstPosition = source.frames.front().mPosition;
+        const float* lastPosition = source.frames.back().mPosition;
+        constant = true;
+        linear = true;
+        for (size_t frame = 0; frame < frameCount && (constant || linear); frame++) {
+            const float* actual = source.frames[frame].mPosition;
+            float blended[3];
+            float t = frameCount > 1 ? float(frame) / float(frameCount - 1) : 0.0f;
+            blendPosition(firstPosition, lastPosition, t, blended);
+            for (int c = 0; c < 3; c++) {
+                constant = constant && std::fabs(actual[c] - firstPosition[c]) <= options.positionTolerance;
+                linear = linear && std::fabs(actual[c] - blended[c]) <= options.positionTolerance;
+            }
+        }
+        if (constant) {
+            track.mPositionMode = constantTrack;
+            track.mPositionOffset = (unsigned int)(tableBytes + pool.size() * sizeof(float));
+            appendFloats(pool, firstPosition, 3);
+        }
+        else if (linear) {
+            track.mPositionMode = linearTrack;
+            track.mPositionOffset = (unsigned int)(tableBytes + pool.size() * sizeof(float));
+            appendFloats(pool, firstPosition, 3);
+            appendFloats(pool, lastPosition, 3);
+        }
+        else {
+            track.mPositionMode = animatedTrack;
+            animatedPositions.push_back(bone);
+        }
+    }
+
+    // Positions first so the floats stay aligned whatever size the rotations are.
+    size_t rotationSize = quantized ? QuantizedRotationSize : 4 * sizeof(float);
+    size_t offset = 0;
+    for (auto bone : animatedPositions) {
+        tracks[bone].mPositionOffset = (unsigned int)offset;
+        offset += 3 * sizeof(float);
+    }
+    for (auto bone : animatedRotations) {
+        tracks[bone].mRotationOffset = (unsigned int)offset;
+        offset += rotationSize;
+    }
+    frameStride = (offset + 3) & ~size_t(3);
+    framesOffset = tableBytes + pool.size() * sizeof(float);
+
+    data.resize(framesOffset + frameStride * frameCount);
+    memcpy(data.data(), tracks.data(), tableBytes);
+    memcpy(data.data() + tableBytes, pool.data(), pool.size() * sizeof(float));
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        unsigned char* block = data.data() + framesOffset + frame * frameStride;
+        for (auto bone : animatedPositions) {
+            memcpy(block + tracks[bone].mPositionOffset, animation.bones[bone].frames[frame].mPosition, 3 * sizeof(float));
+        }
+        for (auto bone : animatedRotations) {
+            float rotation[4];
+            memcpy(rotation, animation.bones[bone].frames[frame].mOrientation, sizeof(rotation));
+            if (quantized) {
+                normalize(rotation);
+                unsigned short packed[3];
+                quantizeRotation(rotation, packed);
+                memcpy(block + tracks[bone].mRotationOffset, packed, sizeof(packed));
+            }
+            else {
+                memcpy(block + tracks[bone].mRotationOffset, rotation, sizeof(rotation));
+            }
+        }
+    }
+}
+
+std::string RiotCompactAnimation::getBoneName(size_t bone) const {
+    ANMenforce(bone < boneCount, "Bad bone index supplied to getBoneName");
+    const auto& track = ((const Track_t*)data.data())[bone];
+    return std::string(track.mName, std::find(track.mName, track.mName + sizeof(track.mName), '\0'));
+}
+
+RiotCompactAnimation::Stats RiotCompactAnimation::getStats() const {
+    Stats stats;
+    stats.constantTracks = 0;
+    stats.linearTracks = 0;
+    stats.animatedTracks = 0;
+    stats.bytes = sizeof(*this) + data.capacity();
+    const Track_t* tracks = (const Track_t*)data.data();
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        for (int mode : { (int)tracks[bone].mRotationMode, (int)tracks[bone].mPositionMode }) {
+            if (mode == constantTrack) {
+                stats.constantTracks++;
+            }
+            else if (mode == linearTrack) {
+                stats.linearTracks++;
+            }
+            else {
+                stats.animatedTracks++;
+            }
+        }
+    }
+    return stats;
+}
+
+void RiotCompactAnimation::readBone(size_t bone, size_t frame, ANM::BoneFrame_t& out) const {
+    const auto& track = ((const Track_t*)data.data())[bone];
+    const unsigned char* block = data.data() + framesOffset + frame * frameStride;
+    float t = frameCount > 1 ? float(frame) / float(frameCount - 1) : 0.0f;
+
+    if (track.mRotationMode == animatedTrack) {
+        if (quantized) {
+            unsigned short packed[3];
+            memcpy(packed, block + track.mRotationOffset, sizeof(packed));
+            dequantizeRotation(packed, out.mOrientation);
+        }
+        else {
+            memcpy(out.mOrientation, block + track.mRotationOffset, sizeof(out.mOrientation));
+        }
+    }
+    else {
+        const float* values = (const float*)(data.data() + track.mRotationOffset);
+        if (track.mRotationMode == linearTrack) {
+            blendRotation(values, values + 4, t, out.mOrientation);
+        }
+        else {
+            memcpy(out.mOrientation, values, sizeof(out.mOrientation));
+        }
+    }
+
+    if (track.mPositionMode == animatedTrack) {
+        memcpy(out.mPosition, block + track.mPositionOffset, sizeof(out.mPosition));
+    }
+    else {
+        const float* values = (const float*)(data.data() + track.mPositionOffset);
+        if (track.mPositionMode == linearTrack) {
+            blendPosition(values, values + 3, t, out.mPosition);
+        }
+        else {
+            memcpy(out.mPosition, values, sizeof(out.mPosition));
+        }
+    }
+}
+
+void RiotCompactAnimation::sampleFrame(size_t frame, ANM::BoneFrame_t* out) const {
+    ANMenforce(frame < frameCount, "Bad frame supplied to sampleFrame");
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        readBone(bone, frame, out[bone]);
+    }
+}
+
+void RiotCompactAnimation::sampleTime(float time, bool loop, ANM::BoneFrame_t* out) const {
+    ANMenforce(frameCount > 0 && fps > 0, "Animation has no frames to sample");
+    size_t lastFrame = frameCount - 1;
+    double position = double(time) * fps;
+    if (loop) {
+        position = std::fmod(position, double(frameCount));
+        if (position < 0) {
+            position += frameCount;
+        }
+    }
+    else {
+        position = std::max(0.0, std::min(position, double(lastFrame)));
+    }
+    size_t frame = std::min(size_t(position), lastFrame);
+    size_t next = frame == lastFrame ? (loop ? 0 : lastFrame) : frame + 1;
+    float alpha = float(position - double(frame));
+
+    for (size_t bone = 0; bone < boneCount; bone++) {
+        ANM::BoneFrame_t a, b;
+        readBone(bone, frame, a);
+        readBone(bone, next, b);
+        normalize(a.mOrientation);
+        normalize(b.mOrientation);
+        blendRotation(a.mOrientation, b.mOrientation, alpha, out[bone].mOrientation);
+        blendPosition(a.mPosition, b.mPosition, alpha, out[bone].mPosition);
+    }
+}
@@ -0,0 +1,73 @@
+#include "RiotFiles/RiotDiagnostics.h"
+
+#include "RiotFiles/RiotSkin.h"
+
+#include <atomic>
+#include <iostream>
+
+static std::atomic<RiotDiagnostics*> diagnosticsSink(nullptr);
+
+void RiotDiagnostics::setSink(RiotDiagnostics* sink) {
+    diagnosticsSink.store(sink);
+}
+
+RiotDiagnostics* RiotDiagnostics::getSink() {
+    return diagnosticsSink.load(std::memory_order_acquire);
+}
+
+RiotConsoleDiagnostics::RiotConsoleDiagnostics() : out(std::cout) {
+}
+
+RiotConsoleDiagnostics::RiotConsoleDiagnostics(std::ostream& _out) : out(_out) {
+}
+
+void RiotConsoleDiagnostics::loaded(const RiotSkin& skin) {
+    auto stats = skin.getStats();
+    out << "SKN magic: " << skin.header.mMagic << std::endl;
+    out << "SKN version: " << skin.header.mVersion << std::endl;
+    out << "SKN objects: " << skin.toc.mObjectCount << std::endl;
+    out << "SKN materials: " << stats.materialCount << std::endl;
+    for (const auto& material : skin.materialHeaders) {
+        out << "\t" << material.mMaterialName << " " << material.mVertexCount << " " << material.mIndexCount << std::endl;
+    }
+
+    out << "SKN vertices: " << stats.vertexCount << std::endl;
+    out << "SKN indices: " << stats.indexCount << std::endl;
+
+    out << "SKN max referenced boneid: " << stats.maxBoneIndex << std::endl;
+    out << "SKN unique referenced boneid: " << stats.referencedBones.count() << std::endl;
+    for (size_t idx = 0; idx < stats.referencedBones.size(); idx++) {
+        if (stats.referencedBones[idx]) {
+            out << "\t" << idx << std::endl;
+        }
+    }
+    out << std::endl;
+}
+
+void RiotConsoleDiagnostics::loaded(const RiotSkeleton& skeleton) {
+    out << "SKL magic: " << std::string(skeleton.header.mMagic, 8) << std::endl;
+    out << "SKL version: " << skeleton.header.mVersion << std::endl;
+    out << "SKL Designer: " << skeleton.designerId << std::endl;
+    out << "SKL Bonecount: " << skeleton.bones.size() << std::endl;
+    for (size_t idx = 0; idx < skeleton.bones.size(); idx++) {
+        const auto& bone = skeleton.bones[idx];
+        out << "\t" << idx << " " << bone.mParentId << " " << bone.mName << " " << bone.mScale << std::endl;
+    }
+    out << "SKL BoneIdCount: " << skeleton.boneIds.size() << std::endl;
+    for (size_t idx = 0; idx < skeleton.boneIds.size(); idx++) {
+        out << "\t" << idx << " " << skeleton.boneIds[idx] << std::endl;
+    }
+}
+
+void RiotConsoleDiagnostics::loaded(const RiotAnimation& animation) {
+    out << "ANM magic: " << std::string(animation.header.mMagic, 8) << std::endl;
+    out << "ANM version: " << animation.header.mVersion << std::endl;
+    out << "ANM Designer: " << animation.designerId << std::endl;
+    out << "ANM Frames: " << animation.frameCount << std::endl;
+    out << "ANM FPS: " << animation.fps << std::endl;
+    out << "ANM Bonecount: " << animation.bones.size() << std::endl;
+    for (size_t idx = 0; idx < animation.bones.size(); idx++) {
+        const auto& bone = animation.bones[idx];
+        out << "\t" << idx << " " << bone.bone.mName << " " << bone.bone.unknown << std::endl;
+    }
+}
@@ -0,0 +1,343 @@
+#include "RiotFiles/RiotPoseEvaluator.h"
+
+#include "RiotFiles/Platform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIOT_SSE2
+#endif
+
+// Four poses side by side, one per lane. All the math below is written once against these few
+// operations, with SSE2 or plain arrays underneath.
+namespace {
+#ifdef RIOT_SSE2
+    typedef __m128 Lanes;
+
+    inline Lanes splat(float value) { return _mm_set1_ps(value); }
+    inline Lanes load(const float* values) { return _mm_loadu_ps(values); }
+    inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+    inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+    inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+    inline Lanes div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+    inline Lanes squareRoot(Lanes a) { return _mm_sqrt_ps(a); }
+    // a with its sign flipped in the lanes where sign is negative.
+    inline Lanes flipSign(Lanes a, Lanes sign) {
+        return _mm_xor_ps(a, _mm_and_ps(sign, _mm_set1_ps(-0.0f)));
+    }
+#else
+    struct Lanes {
+        float v[4];
+    };
+
+    template <typename Op>
+    inline Lanes apply(Lanes a, Lanes b, Op op) {
+        Lanes r;
+        for (int l = 0; l < 4; l++) {
+            r.v[l] = op(a.v[l], b.v[l]);
+        }
+        return r;
+    }
+    inline Lanes splat(float value) { Lanes r = { { value, value, value, value } }; return r; }
+    inline Lanes load(const float* values) { Lanes r; memcpy(r.v, values, sizeof(r.v)); return r; }
+    inline Lanes add(Lanes a, Lanes b) { return apply(a, b, [](float x, float y) { return x + y; }); }
+    inline Lanes sub(Lanes a, Lanes b) { return apply(a, b, [](float x, float y) { return x - y; }); }
+    inline Lanes mul(Lanes a, Lanes b) { return apply(a, b, [](float x, float y) { return x * y; }); }
+    inline Lanes div(Lanes a, Lanes b) { return apply(a, b, [](float x, float y) { return x / y; }); }
+    inline Lanes squareRoot(Lanes a) { return apply(a, a, [](float x, float) { return std::sqrt(x); }); }
+    inline Lanes flipSign(Lanes a, Lanes sign) {
+        return apply(a, sign, [](float x, float s) { return std::signbit(s) ? -x : x; });
+    }
+#endif
+
+    struct LaneMatrix {
+        Lanes m[12];
+    };
+
+    struct AlignedFree {
+        void operator()(LaneMatrix* ptr) const {
+            Platform::alignedFree(ptr);
+        }
+    };
+
+    void broadcast(const RiotBoneMatrix& matrix, LaneMatrix& out) {
+        for (int e = 0; e < 12; e++) {
+            out.m[e] = splat(matrix.m[e]);
+        }
+    }
+
+    // out = a * b, for affine 3x4 matrices. out must not be a or b.
+    void multiply(const LaneMatrix& a, const LaneMatrix& b, LaneMatrix& out) {
+        for (int row = 0; row < 3; row++) {
+            const Lanes* r = a.m + row * 4;
+            for (int col = 0; col < 4; col++) {
+                Lanes sum = add(add(mul(r[0], b.m[col]), mul(r[1], b.m[4 + col])), mul(r[2], b.m[8 + col]));
+                out.m[row * 4 + col] = col == 3 ? add(sum, r[3]) : sum;
+            }
+        }
+    }
+
+    void fromQuaternion(Lanes x, Lanes y, Lanes z, Lanes w, Lanes px, Lanes py, Lanes pz, LaneMatrix& out) {
+        Lanes x2 = add(x, x), y2 = add(y, y), z2 = add(z, z);
+        Lanes xx = mul(x, x2), yy = mul(y, y2), zz = mul(z, z2);
+        Lanes xy = mul(x, y2), xz = mul(x, z2), yz = mul(y, z2);
+        Lanes wx = mul(w, x2), wy = mul(w, y2), wz = mul(w, z2);
+        Lanes one = splat(1.0f);
+        out.m[0] = sub(one, add(yy, zz));
+        out.m[1] = sub(xy, wz);
+        out.m[2] = add(xz, wy);
+        out.m[3] = px;
+        out.m[4] = add(xy, wz);
+        out.m[5] = sub(one, add(xx, zz));
+        out.m[6] = sub(yz, wx);
+        out.m[7] = py;
+        out.m[8] = sub(xz, wy);
+        out.m[9] = add(yz, wx);
+        out.m[10] = sub(one, add(xx, yy));
+        out.m[11] = pz;
+    }
+
+    // Writes lane l to out[l * stride], for the first laneCount lanes.
+    void store(const LaneMatrix& matrix, RiotBoneMatrix* out, size_t stride, size_t laneCount) {
+#ifdef RIOT_SSE2
+        for (int block = 0; block < 3; block++) {
+            Lanes r0 = matrix.m[block * 4], r1 = matrix.m[block * 4 + 1];
+            Lanes r2 = matrix.m[block * 4 + 2], r3 = matrix.m[block * 4 + 3];
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            Lanes rows[4] = { r0, r1, r2, r3 };
+            for (size_t l = 0; l < laneCount; l++) {
+                _mm_storeu_ps(out[l * stride].m + block * 4, rows[l]);
+            }
+        }
+#else
+        for (size_t l = 0; l < laneCount; l++) {
+            for (int e = 0; e < 12; e++) {
+                out[l * stride].m[e] = matrix.m[e].v[l];
+            }
+        }
+#endif
+    }
+
+    RiotBoneMatrix multiply(const RiotBoneMatrix& a, const RiotBoneMatrix& b) {
+        RiotBoneMatrix out;
+        for (int row = 0; row < 3; row++) {
+            const float* r = a.m + row * 4;
+            for (int col = 0; col < 4; col++) {
+                out.m[row * 4 + col] = r[0] * b.m[col] + r[1] * b.m[4 + col] + r[2] * b.m[8 + col] + (col == 3 ? r[3] : 0.0f);
+            }
+        }
+        return out;
+    }
+
+    RiotBoneMatrix inverse(const RiotBoneMatrix& a) {
+        const float* m = a.m;
+        float c00 = m[5] * m[10] - m[6] * m[9];
+        float c01 = m[6] * m[8] - m[4] * m[10];
+        float c02 = m[4] * m[9] - m[5] * m[8];
+        float det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+        SKLenforce(det != 0.0f && std::isfinite(det), "Bone matrix in SKL file can not be inverted");
+        float inv = 1.0f / det;
+
+        RiotBoneMatrix out;
+        float* r = out.m;
+        r[0] = c00 * inv;
+        r[1] = (m[2] * m[9] - m[1] * m[10]) * inv;
+        r[2] = (m[1] * m[6] - m[2] * m[5]) * inv;
+        r[4] = c01 * inv;
+        r[5] = (m[0] * m[10] - m[2] * m[8]) * inv;
+        r[6] = (m[2] * m[4] - m[0] * m[6]) * inv;
+        r[8] = c02 * inv;
+        r[9] = (m[1] * m[8] - m[0] * m[9]) * inv;
+        r[10] = (m[0] * m[5] - m[1] * m[4]) * inv;
+        for (int row = 0; row < 3; row++) {
+            r[row * 4 + 3] = -(r[row * 4] * m[3] + r[row * 4 + 1] * m[7] + r[row * 4 + 2] * m[11]);
+        }
+        return out;
+    }
+}
+
+struct RiotPoseEvaluator::Samples {
+    std::vector<size_t> frame0;
+    std::vector<size_t> frame1;
+    std::vector<float> alpha;
+    bool blend;
+};
+
+RiotPoseEvaluator::RiotPoseEvaluator(const RiotSkeleton& skeleton, const RiotAnimation& _animation)
+    : animation(&_animation)
+{
+    std::unordered_map<std::string, int> trackByName;
+    for (size_t idx = 0; idx < animation->bones.size(); idx++) {
+        const auto& track = animation->bones[idx].bone;
+        trackByName[std::string(track.mName, std::find(track.mName, track.mName + sizeof(track.mName), '\0'))] = (int)idx;
+    }
+
+    size_t boneCount = skeleton.bones.size();
+    parents.resize(boneCount);
+    tracks.resize(boneCount);
+    bindLocal.resize(boneCount);
+    inverseBind.resize(boneCount);
+    for (size_t idx = 0; idx < boneCount; idx++) {
+        const auto& bone = skeleton.bones[idx];
+        SKLenforce(bone.mParentId < (int)idx, "Bad parent relation found in SKL file");
+        parents[idx] = bone.mParentId < 0 ? -1 : bone.mParentId;
+
+        auto track = trackByName.find(std::string(bone.mName, std::find(bone.mName, bone.mName + sizeof(bone.mName), '\0')));
+        tracks[idx] = track == trackByName.end() ? -1 : track->second;
+
+        RiotBoneMatrix bindWorld;
+        memcpy(bindWorld.m, bone.mMatrix, sizeof(bindWorld.m));
+        inverseBind[idx] = inverse(bindWorld);
+        bindLocal[idx] = parents[idx] < 0 ? bindWorld : multiply(inverseBind[parents[idx]], bindWorld);
+    }
+
+    for (auto boneId : skeleton.boneIds) {
+        SKLenforce(0 <= boneId && size_t(boneId) < boneCount, "Bone id out of range in SKL file");
+        paletteBones.push_back(boneId);
+    }
+}
+
+size_t RiotPoseEvaluator::getMatrixCount(Output output) const {
+    return output == Output::palette ? paletteBones.size() : parents.size();
+}
+
+void RiotPoseEvaluator::evaluateFrames(size_t firstFrame, size_t frameCount, Output output, RiotBoneMatrix* out) const {
+    ANMenforce(firstFrame <= animation->frameCount && frameCount <= animation->frameCount - firstFrame,
+        "Frame range outside of the animation");
+    Samples samples;
+    samples.blend = false;
+    for (size_t frame = firstFrame; frame < firstFrame + frameCount; frame++) {
+        samples.frame0.push_back(frame);
+        samples.frame1.push_back(frame);
+        samples.alpha.push_back(0.0f);
+    }
+    evaluate(samples, output, out);
+}
+
+void RiotPoseEvaluator::evaluateTimes(const float* times, size_t timeCount, Output output, bool loop, RiotBoneMatrix* out) const {
+    ANMenforce(animation->frameCount > 0 && animation->fps > 0, "Animation has no frames to sample");
+    size_t frameCount = animation->frameCount;
+    size_t lastFrame = frameCount - 1;
+    Samples samples;
+    samples.blend = true;
+    for (size_t idx = 0; idx < timeCount; idx++) {
+        double position = double(times[idx]) * animation->fps;
+        if (loop) {
+            position = std::fmod(position, double(frameCount));
+            if (position < 0) {
+                position += frameCount;
+            }
+        }
+        else {
+            position = std::max(0.0, std::min(position, double(lastFrame)));
+        }
+        size_t frame = std::min(size_t(position), lastFrame);
+        size_t next = frame == lastFrame ? (loop ? 0 : lastFrame) : frame + 1;
+        samples.frame0.push_back(frame);
+        samples.frame1.push_back(next);
+        samples.alpha.push_back(float(position - double(frame)));
+    }
+    evaluate(samples, output, out);
+}
+
+void RiotPoseEvaluator::evaluate(const Samples& samples, Output output, RiotBoneMatrix* out) const {
+    size_t boneCount = parents.size();
+    size_t matrixCount = getMatrixCount(output);
+    size_t poseCount = samples.frame0.size();
+
+    std::unique_ptr<LaneMatrix, AlignedFree> world(
+        (LaneMatrix*)Platform::alignedAlloc(std::max<size_t>(boneCount, 1) * sizeof(LaneMatrix), 16));
+    if (!world) {
+        throw std::bad_alloc();
+    }
+
+    for (size_t first = 0; first < poseCount; first += 4) {
+        size_t laneCount = std::min<size_t>(4, poseCount - first);
+        // Unused lanes repeat the last pose rather than reading garbage.
+        size_t frame0[4], frame1[4];
+        float alpha[4];
+        for (size_t l = 0; l < 4; l++) {
+            size_t pose = first + std::min(l, laneCount - 1);
+            frame0[l] = samples.frame0[pose];
+            frame1[l] = samples.frame1[pose];
+            alpha[l] = samples.alpha[pose];
+        }
+
+        for (size_t bone = 0; bone < boneCount; bone++) {
+            LaneMatrix local;
+            if (tracks[bone] < 0) {
+                broadcast(bindLocal[bone], local);
+            }
+            else {
+                const auto& frames = animation->bones[tracks[bone]].frames;
+                // [component][lane], quaternion x y z w then position x y z.
+                float a[7][4], b[7][4];
+                for (size_t l = 0; l < 4; l++) {
+                    const auto& fa = frames[frame0[l]];
+                    const auto& fb = frames[frame1[l]];
+                    for (int c = 0; c < 4; c++) {
+                        a[c][l] = fa.mOrientation[c];
+                        b[c][l] = fb.mOrientation[c];
+                    }
+                    for (int c = 0; c < 3; c++) {
+                        a[4 + c][l] = fa.mPosition[c];
+                        b[4 + c][l] = fb.mPosition[c];
+                    }
+                }
+                Lanes v[7];
+                for (int c = 0; c < 7; c++) {
+                    v[c] = load(a[c]);
+                }
+                if (samples.blend) {
+                    Lanes t = load(alpha);
+                    Lanes w[7];
+                    for (int c = 0; c < 7; c++) {
+                        w[c] = load(b[c]);
+                    }
+                    // Take the short way around.
+                    Lanes dot = add(add(mul(v[0], w[0]), mul(v[1], w[1])), add(mul(v[2], w[2]), mul(v[3], w[3])));
+                    for (int c = 0; c < 4; c++) {
+                        w[c] = flipSign(w[c], dot);
+                    }
+                    for (int c = 0; c < 7; c++) {
+                        v[c] = add(v[c], mul(sub(w[c], v[c]), t));
+                    }
+                    Lanes length = squareRoot(add(add(mul(v[0], v[0]), mul(v[1], v[1])), add(mul(v[2], v[2]), mul(v[3], v[3]))));
+                    for (int c = 0; c < 4; c++) {
+                        v[c] = div(v[c], length);
+                    }
+                }
+                fromQuaternion(v[0], v[1], v[2], v[3], v[4], v[5], v[6], local);
+            }
+
+            LaneMatrix* target = world.get() + bone;
+            if (parents[bone] < 0) {
+                *target = local;
+            }
+            else {
+                multiply(world.get()[parents[bone]], local, *target);
+            }
+        }
+
+        RiotBoneMatrix* poseOut = out + first * matrixCount;
+        for (size_t idx = 0; idx < matrixCount; idx++) {
+            size_t bone = output == Output::palette ? paletteBones[idx] : idx;
+            if (output == Output::world) {
+                store(world.get()[bone], poseOut + idx, matrixCount, laneCount);
+            }
+            else {
+                LaneMatrix inverseBindLanes, skinning;
+                broadcast(inverseBind[bone], inverseBindLanes);
+                multiply(world.get()[bone], inverseBindLanes, skinning);
+                store(skinning, poseOut + idx, matrixCount, laneCount);
+            }
+        }
+    }
+}
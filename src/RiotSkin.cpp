@@ -1,71 +1,55 @@
-#include "RiotFiles\RiotSkin.h"
+#include "RiotFiles/RiotSkin.h"
 
-#include "RiotFiles\RiotArchiveFile.h"
+#include "RiotFiles/RiotArchiveFile.h"
+#include "RiotFiles/RiotDiagnostics.h"
 
-#include <iostream>
-#include <set>
+#include "MemCursor.h"
 
-#define MemRead(X, Y)   (*(Y*)(X)); (X)+=sizeof(Y);
+#ifdef RIOTFILES_NO_DIAGNOSTICS
+#define RIOTdiagnose(X)
+#else
+#define RIOTdiagnose(X) if (auto sink = RiotDiagnostics::getSink()) { sink->loaded((X)); }
+#endif
 
 void RiotSkin::load(const void* data, size_t length) {
     dispose();
-    char* ptr = (char*)data;
-    header = MemRead(ptr, SKN::Header_t);
+    MemCursor<RiotSkinException> cursor(data, length, "SKN");
+    header = cursor.read<SKN::Header_t>("header");
 
     SKNenforce(header.mMagic == 0x112233, "Magic header wrong when trying to load SKN file");
     SKNenforce(0 < header.mVersion && header.mVersion < 3, "Unsupported version of SKN file(Supports version 1 & 2)");
 
-    toc = MemRead(ptr, SKN::TableOfContents_t);
+    toc = cursor.read<SKN::TableOfContents_t>("table of contents");
+    cursor.copy(materialHeaders, toc.mMaterialCount, "materials");
+    meshHeader = cursor.read<SKN::MeshHeader_t>("mesh header");
+    cursor.copy(indices, meshHeader.mIndexCount, "indices");
+    cursor.copy(vertices, meshHeader.mVertexCount, "vertices");
 
-    SKN::MaterialHeader_t material;
-    for (unsigned int idx = 0; idx < toc.mMaterialCount; idx++) {
-        material = MemRead(ptr, SKN::MaterialHeader_t);
-        materialHeaders.push_back(material);
-    }
-    meshHeader = MemRead(ptr, SKN::MeshHeader_t);
-
-    indices.reserve(meshHeader.mIndexCount);
-    unsigned short *indexPtr = (unsigned short*)ptr;
-    indices.insert(indices.end(), indexPtr, indexPtr + meshHeader.mIndexCount);
-    ptr += meshHeader.mIndexCount * sizeof(unsigned short);
-
-    SKN::Vertex_t* vertPtr = (SKN::Vertex_t*)ptr;
-    vertices.reserve(meshHeader.mVertexCount);
-    vertices.insert(vertices.end(), vertPtr, vertPtr + meshHeader.mVertexCount);
-    ptr += meshHeader.mVertexCount * sizeof(SKN::Vertex_t);
-    
     if (header.mVersion == 2) {
-        endData = MemRead(ptr, SKN::EndData_t);
+        endData = cursor.read<SKN::EndData_t>("end data");
     }
 
-    if (true) {
-        std::cout << "SKN magic: " << header.mMagic << std::endl;
-        std::cout << "SKN version: " << header.mVersion << std::endl;        
-        std::cout << "SKN objects: " << toc.mObjectCount << std::endl;
-        std::cout << "SKN materials: " << toc.mMaterialCount << std::endl;
-        for (auto material : materialHeaders) {
-            std::cout << "\t" << material.mMaterialName << " " << material.mVertexCount << " " << material.mVertexCount << std::endl;
-        }
-
-        std::cout << "SKN vertices: " << meshHeader.mVertexCount << std::endl;
-        std::cout << "SKN indices: " << meshHeader.mIndexCount << std::endl;
+    RIOTdiagnose(*this);
+}
 
-        int max = 0;
-        std::set<int> referenced;
-        for (auto vert : vertices) {
-            for (int i = 0; i < 4; i++) {
-                max = max < vert.mBoneIndices[i] ? vert.mBoneIndices[i] : max;
-                referenced.insert(vert.mBoneIndices[i]);
-            }
+RiotSkin::Stats RiotSkin::getStats() const {
+    Stats stats;
+    stats.materialCount = materialHeaders.size();
+    stats.vertexCount = vertices.size();
+    stats.indexCount = indices.size();
+    stats.maxBoneIndex = 0;
+    for (const auto& vert : vertices) {
+        for (int i = 0; i < 4; i++) {
+            stats.referencedBones.set(vert.mBoneIndices[i]);
         }
-
-        std::cout << "SKN max referenced boneid: " << max << std::endl;
-        std::cout << "SKN unique referenced boneid: " << referenced.size() << std::endl;
-        for (auto idx : referenced) {
-            std::cout << "\t" << idx << std::endl;
+    }
+    for (size_t idx = stats.referencedBones.size(); idx-- > 0;) {
+        if (stats.referencedBones[idx]) {
+            stats.maxBoneIndex = (unsigned int)idx;
+            break;
         }
-        std::cout << std::endl;
     }
+    return stats;
 }
 
 
@@ -76,41 +60,32 @@ void RiotSkin::dispose() {
 
 void RiotSkeleton::load(const void* data, size_t length) {
     dispose();
-    char* ptr = (char*)data;
+    MemCursor<RiotSkeletonException> cursor(data, length, "SKL");
 
-    header = MemRead(ptr, SKL::Header_t);
+    header = cursor.read<SKL::Header_t>("header");
 
     SKLenforce(std::string(header.mMagic, 8) == "r3d2sklt", "Magic header wrong when trying to load SKN file");
     SKLenforce(0 < header.mVersion && header.mVersion < 3, "Unsupported version of SKL file(Supports version 1 & 2)");
 
     if (header.mVersion == 1 || header.mVersion == 2) {
-        designerId = MemRead(ptr, unsigned int);
-        auto boneCount = MemRead(ptr, unsigned int);
-
-        bones.reserve(boneCount);
-        for (unsigned int idx = 0; idx < boneCount; idx++) {
-            auto bone = MemRead(ptr, SKL::Bone_t);
-            bones.push_back(bone);
-        }
+        designerId = cursor.read<unsigned int>("designer id");
+        auto boneCount = cursor.read<unsigned int>("bone count");
+        cursor.copy(bones, boneCount, "bones");
 
         if (header.mVersion == 1) {
             for (unsigned int idx = 0; idx < boneCount; idx++) {
                 boneIds.push_back(idx);
             }
         } else {
-            auto boneIdCount = MemRead(ptr, unsigned int);
-            boneIds.reserve(boneIdCount);
-            for (unsigned int idx = 0; idx < boneIdCount; idx++) {
-                auto boneId = MemRead(ptr, unsigned int);
-                boneIds.push_back(boneId);
-            }
+            auto boneIdCount = cursor.read<unsigned int>("bone id count");
+            cursor.copy(boneIds, boneIdCount, "bone ids");
         } 
     }
     else if (header.mVersion == 0) { 
 
-        auto zero = MemRead(ptr, unsigned short);
-        auto boneCount = MemRead(ptr, unsigned short);
-        auto boneIdCount = MemRead(ptr, unsigned int);
+        auto zero = cursor.read<unsigned short>("header");
+        auto boneCount = cursor.read<unsigned short>("bone count");
+        auto boneIdCount = cursor.read<unsigned int>("bone id count");
         bones.reserve(boneCount);
         boneIds.reserve(boneIdCount);
         throw RiotSkeletonException("SKL version 0 not implemented yet");
@@ -119,22 +94,18 @@ void RiotSkeleton::load(const void* data, size_t length) {
         throw RiotSkeletonException("Unsupported version of SKL encountered");    
     }
 
-    if (true) {
-        std::cout << "SKL magic: " << std::string(this->header.mMagic, 8) << std::endl;
-        std::cout << "SKL version: " << this->header.mVersion << std::endl;
-        std::cout << "SKL Designer: " << this->designerId << std::endl;
-        std::cout << "SKL Bonecount: " << this->bones.size() << std::endl;
-        for (size_t idx = 0; idx < bones.size(); idx++) {
-            const auto& bone = bones[idx];
-            std::cout << "\t" << idx << " " << bone.mParentId << " " << bone.mName << " " << bone.mScale << std::endl;
-            SKLenforce(ptrdiff_t(idx) > bone.mParentId, "Bad parent relation found in SKL file");
-        }
-        std::cout << "SKL BoneIdCount: " << this->boneIds.size() << std::endl;
-        for (size_t idx = 0; idx < boneIds.size(); idx++) {
-            const auto& id = boneIds[idx];
-            std::cout << "\t" << idx << " " << id << std::endl;
-        }
+    for (size_t idx = 0; idx < bones.size(); idx++) {
+        SKLenforce(ptrdiff_t(idx) > bones[idx].mParentId, "Bad parent relation found in SKL file");
     }
+
+    RIOTdiagnose(*this);
+}
+
+RiotSkeleton::Stats RiotSkeleton::getStats() const {
+    Stats stats;
+    stats.boneCount = bones.size();
+    stats.boneIdCount = boneIds.size();
+    return stats;
 }
 
 void RiotSkeleton::dispose() {
@@ -144,41 +115,43 @@ void RiotSkeleton::dispose() {
 
 
 void RiotAnimation::load(const void* data, size_t length) {
-    char* ptr = (char*)data;
-    header = MemRead(ptr, ANM::Header_t);
+    MemCursor<RiotAnimationException> cursor(data, length, "ANM");
+    header = cursor.read<ANM::Header_t>("header");
 
     ANMenforce(std::string(header.mMagic, 8) == "r3d2anmd", "Wrong magic header for riot animation file.");
     ANMenforce(0 <= header.mVersion && header.mVersion < 5, "Only supports versions 0-4 of ANM files.");
 
     if (0 <= header.mVersion && header.mVersion <= 4) {
-        designerId = MemRead(ptr, unsigned int);
-        boneCount = MemRead(ptr, unsigned int);
-        frameCount = MemRead(ptr, unsigned int);
-        fps = MemRead(ptr, unsigned int);
-
+        designerId = cursor.read<unsigned int>("designer id");
+        boneCount = cursor.read<unsigned int>("bone count");
+        frameCount = cursor.read<unsigned int>("frame count");
+        fps = cursor.read<unsigned int>("fps");
+
+        // All of it up front, so a broken count fails before allocating anything.
+        if (boneCount) {
+            cursor.expect(frameCount, sizeof(ANM::BoneFrame_t), "frames");
+            cursor.expect(boneCount, sizeof(ANM::Bone_t) + frameCount * sizeof(ANM::BoneFrame_t), "bones");
+        }
         bones.resize(boneCount);
         for (auto& bone : bones) {
-            bone.bone = MemRead(ptr, ANM::Bone_t);
-            bone.frames.resize(frameCount);
-            for (auto& frame : bone.frames) {
-                frame = MemRead(ptr, ANM::BoneFrame_t);
-            }
+            bone.bone = cursor.read<ANM::Bone_t>("bone");
+            cursor.copy(bone.frames, frameCount, "frames");
         }
     }
     else {
         throw RiotAnimationException("Unsupported version of ANM file");
     }
 
-    std::cout << "ANM magic: " << std::string(this->header.mMagic, 8) << std::endl;
-    std::cout << "ANM version: " << this->header.mVersion << std::endl;
-    std::cout << "ANM Designer: " << this->designerId << std::endl;
-    std::cout << "ANM Frames: " << this->frameCount << std::endl;
-    std::cout << "ANM FPS: " << this->fps << std::endl;
-    std::cout << "ANM Bonecount: " << this->bones.size() << std::endl;
-    for (size_t idx = 0; idx < bones.size(); idx++) {
-        const auto& bone = bones[idx];
-        std::cout << "\t" << idx << " " << bone.bone.mName << " " << bone.bone.unknown << std::endl;
-    }
+    RIOTdiagnose(*this);
+}
+
+RiotAnimation::Stats RiotAnimation::getStats() const {
+    Stats stats;
+    stats.boneCount = bones.size();
+    stats.frameCount = frameCount;
+    stats.fps = fps;
+    stats.duration = fps ? float(frameCount) / float(fps) : 0.0f;
+    return stats;
 }
 
 void RiotAnimation::dispose() {
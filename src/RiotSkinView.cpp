@@ -0,0 +1,36 @@
+#include "RiotFiles/RiotSkinView.h"
+
+#include "RiotFiles/MMFile.h"
+
+#include "MemCursor.h"
+
+#include <cstdint>
+
+RiotSkinView::RiotSkinView(const void* data, size_t length, std::shared_ptr<const void> _owner)
+    : owner(std::move(_owner)), endData(nullptr)
+{
+    SKNenforce(data, "No data given for SKN file");
+    SKNenforce(((uintptr_t)data & 1) == 0, "SKN buffer must be 2 byte aligned");
+    MemCursor<RiotSkinException> cursor(data, length, "SKN");
+
+    header = cursor.take<SKN::Header_t>(1, "header");
+    SKNenforce(header->mMagic == 0x112233, "Magic header wrong when trying to load SKN file");
+    SKNenforce(0 < header->mVersion && header->mVersion < 3, "Unsupported version of SKN file(Supports version 1 & 2)");
+
+    toc = cursor.take<SKN::TableOfContents_t>(1, "table of contents");
+    materialHeaders = ArrayView<SKN::MaterialHeader_t>(
+        cursor.take<SKN::MaterialHeader_t>(toc->mMaterialCount, "materials"), toc->mMaterialCount);
+    meshHeader = cursor.take<SKN::MeshHeader_t>(1, "mesh header");
+    indexArray = ArrayView<unsigned short>(
+        cursor.take<unsigned short>(meshHeader->mIndexCount, "indices"), meshHeader->mIndexCount);
+    vertexArray = ArrayView<SKN::Vertex_t>(
+        cursor.take<SKN::Vertex_t>(meshHeader->mVertexCount, "vertices"), meshHeader->mVertexCount);
+    if (header->mVersion == 2) {
+        endData = cursor.take<SKN::EndData_t>(1, "end data");
+    }
+}
+
+RiotSkinView RiotSkinView::mapFile(const std::string& path) {
+    std::shared_ptr<MMFile> file(new MMFile(path, MMOpenMode::read, 0, MMAccessHint::willNeed));
+    return RiotSkinView(file->getPtr(), file->getSize(), file);
+}
@@ -0,0 +1,245 @@
+#include "RiotFiles/RiotVertexStreams.h"
+
+#include "RiotFiles/Platform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RIOT_SSE2
+#endif
+
+void RiotVertexStreams::AlignedFree::operator()(char* ptr) const {
+    Platform::alignedFree(ptr);
+}
+
+RiotVertexStreams::RiotVertexStreams()
+    : capacity(0), count(0), positionStream(nullptr), normalStream(nullptr), uvStream(nullptr),
+      weightStream(nullptr), boneIndexStream(nullptr)
+{
+}
+
+RiotVertexStreams::RiotVertexStreams(ArrayView<SKN::Vertex_t> vertices)
+    : capacity(0), count(0), positionStream(nullptr), normalStream(nullptr), uvStream(nullptr),
+      weightStream(nullptr), boneIndexStream(nullptr)
+{
+    convert(vertices);
+}
+
+RiotVertexStreams::RiotVertexStreams(RiotVertexStreams&& other)
+    : storage(std::move(other.storage)), capacity(other.capacity), count(other.count),
+      positionStream(other.positionStream), normalStream(other.normalStream), uvStream(other.uvStream),
+      weightStream(other.weightStream), boneIndexStream(other.boneIndexStream)
+{
+    other.capacity = 0;
+    other.count = 0;
+}
+
+RiotVertexStreams& RiotVertexStreams::operator=(RiotVertexStreams&& other) {
+    storage = std::move(other.storage);
+    capacity = other.capacity;
+    count = other.count;
+    positionStream = other.positionStream;
+    normalStream = other.normalStream;
+    uvStream = other.uvStream;
+    weightStream = other.weightStream;
+    boneIndexStream = other.boneIndexStream;
+    other.capacity = 0;
+    other.count = 0;
+    return *this;
+}
+
+void RiotVertexStreams::reserve(size_t vertexCount) {
+    if (vertexCount <= capacity && storage) {
+        return;
+    }
+    // Whole groups of four keep every stream a multiple of 16 bytes long, so they all stay aligned.
+    size_t rounded = (vertexCount + 3) & ~size_t(3);
+    size_t bytesPerVertex = sizeof(float) * (3 + 3 + 2 + 4) + 4;
+    char* block = (char*)Platform::alignedAlloc(std::max<size_t>(rounded * bytesPerVertex, 16), 16);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    storage.reset(block);
+    capacity = rounded;
+    positionStream = (float*)block;
+    normalStream = positionStream + rounded * 3;
+    uvStream = normalStream + rounded * 3;
+    weightStream = uvStream + rounded * 2;
+    boneIndexStream = (unsigned char*)(weightStream + rounded * 4);
+}
+
+void RiotVertexStreams::convert(ArrayView<SKN::Vertex_t> vertices) {
+    count = 0;
+    reserve(vertices.size());
+    count = vertices.size();
+
+    size_t idx = 0;
+#ifdef RIOT_SSE2
+    // Every load stays inside its own vertex, so nothing is read past the end of the array.
+    for (; idx + 4 <= count; idx += 4) {
+        const char* src = (const char*)(vertices.data() + idx);
+        __m128 p[4], n[4], uv[4];
+        for (int i = 0; i < 4; i++) {
+            const char* vert = src + i * sizeof(SKN::Vertex_t);
+            // x y z and the bone indices as a fourth lane, moved around bit for bit.
+            p[i] = _mm_loadu_ps((const float*)(vert + offsetof(SKN::Vertex_t, mXYZ)));
+            n[i] = _mm_loadu_ps((const float*)(vert + offsetof(SKN::Vertex_t, mNormalXYZ)));
+            uv[i] = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(vert + offsetof(SKN::Vertex_t, mUV))));
+            _mm_store_ps(weightStream + (idx + i) * 4, _mm_loadu_ps((const float*)(vert + offsetof(SKN::Vertex_t, mBoneWeights))));
+        }
+
+        // xyz_ xyz_ xyz_ xyz_ -> xyzx yzxy zxyz
+        float* pos = positionStream + idx * 3;
+        __m128 t = _mm_shuffle_ps(p[0], p[1], _MM_SHUFFLE(0, 0, 2, 2));
+        _mm_store_ps(pos, _mm_shuffle_ps(p[0], t, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_store_ps(pos + 4, _mm_shuffle_ps(p[1], p[2], _MM_SHUFFLE(1, 0, 2, 1)));
+        t = _mm_shuffle_ps(p[2], p[3], _MM_SHUFFLE(0, 0, 2, 2));
+        _mm_store_ps(pos + 8, _mm_shuffle_ps(t, p[3], _MM_SHUFFLE(2, 1, 2, 0)));
+
+        float* nrm = normalStream + idx * 3;
+        t = _mm_shuffle_ps(n[0], n[1], _MM_SHUFFLE(0, 0, 2, 2));
+        _mm_store_ps(nrm, _mm_shuffle_ps(n[0], t, _MM_SHUFFLE(2, 0, 1, 0)));
+        _mm_store_ps(nrm + 4, _mm_shuffle_ps(n[1], n[2], _MM_SHUFFLE(1, 0, 2, 1)));
+        t = _mm_shuffle_ps(n[2], n[3], _MM_SHUFFLE(0, 0, 2, 2));
+        _mm_store_ps(nrm + 8, _mm_shuffle_ps(t, n[3], _MM_SHUFFLE(2, 1, 2, 0)));
+
+        _mm_store_ps(uvStream + idx * 2, _mm_movelh_ps(uv[0], uv[1]));
+        _mm_store_ps(uvStream + idx * 2 + 4, _mm_movelh_ps(uv[2], uv[3]));
+
+        __m128 i01 = _mm_unpackhi_ps(p[0], p[1]);
+        __m128 i23 = _mm_unpackhi_ps(p[2], p[3]);
+        _mm_store_ps((float*)(boneIndexStream + idx * 4), _mm_movehl_ps(i23, i01));
+    }
+#endif
+    for (; idx < count; idx++) {
+        const auto& vert = vertices[idx];
+        memcpy(positionStream + idx * 3, vert.mXYZ, sizeof(vert.mXYZ));
+        memcpy(normalStream + idx * 3, vert.mNormalXYZ, sizeof(vert.mNormalXYZ));
+        memcpy(uvStream + idx * 2, vert.mUV, sizeof(vert.mUV));
+        memcpy(weightStream + idx * 4, vert.mBoneWeights, sizeof(vert.mBoneWeights));
+        memcpy(boneIndexStream + idx * 4, vert.mBoneIndices, sizeof(vert.mBoneIndices));
+    }
+}
+
+// Round to nearest even, with overflow going to infinity, same as the F16C instructions.
+static unsigned short floatToHalf(float value) {
+    const unsigned int f32infinity = 255u << 23;
+    const unsigned int f16overflow = (127u + 16) << 23;
+    const unsigned int denormalMagic = ((127u - 15) + (23 - 10) + 1) << 23;
+
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    unsigned short half;
+    if (bits >= f16overflow) {
+        half = bits > f32infinity ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < (113u << 23)) {
+        // Too small for a normal half: adding the magic number lets the FPU do the rounding.
+        float magic, shifted;
+        memcpy(&magic, &denormalMagic, sizeof(magic));
+        memcpy(&shifted, &bits, sizeof(shifted));
+        shifted += magic;
+        memcpy(&bits, &shifted, sizeof(bits));
+        half = (unsigned short)(bits - denormalMagic);
+    }
+    else {
+        unsigned int mantissaOdd = (bits >> 13) & 1;
+        bits += ((unsigned int)(15 - 127) << 23) + 0xfff;
+        bits += mantissaOdd;
+        half = (unsigned short)(bits >> 13);
+    }
+    return (unsigned short)(half | (sign >> 16));
+}
+
+RiotVertexStreams::PackedBounds RiotVertexStreams::pack(ArrayView<SKN::Vertex_t> vertices, PackedVertex_t* out) {
+    PackedBounds bounds;
+    float lo[3] = { 0, 0, 0 }, hi[3] = { 0, 0, 0 };
+    if (!vertices.empty()) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = hi[axis] = vertices[0].mXYZ[axis];
+        }
+    }
+    for (const auto& vert : vertices) {
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = std::min(lo[axis], vert.mXYZ[axis]);
+            hi[axis] = std::max(hi[axis], vert.mXYZ[axis]);
+        }
+    }
+    float scale[3];
+    for (int axis = 0; axis < 3; axis++) {
+        bounds.center[axis] = (lo[axis] + hi[axis]) * 0.5f;
+        bounds.extent[axis] = (hi[axis] - lo[axis]) * 0.5f;
+        scale[axis] = bounds.extent[axis] > 0 ? 32767.0f / bounds.extent[axis] : 0.0f;
+    }
+
+#ifdef RIOT_SSE2
+    const __m128 center = _mm_setr_ps(bounds.center[0], bounds.center[1], bounds.center[2], 0);
+    const __m128 positionScale = _mm_setr_ps(scale[0], scale[1], scale[2], 0);
+    const __m128 normalScale = _mm_setr_ps(127, 127, 127, 0);
+    const __m128 normalMin = _mm_set1_ps(-127);
+    const __m128 weightScale = _mm_set1_ps(255);
+    // The fourth lane of the position and normal loads is something else entirely.
+    const __m128i xyzMask = _mm_setr_epi32(-1, -1, -1, 0);
+#endif
+
+    for (size_t idx = 0; idx < vertices.size(); idx++) {
+        const auto& vert = vertices[idx];
+        auto& packed = out[idx];
+        int weights[4];
+#ifdef RIOT_SSE2
+        const char* src = (const char*)&vert;
+        __m128 p = _mm_loadu_ps((const float*)(src + offsetof(SKN::Vertex_t, mXYZ)));
+        __m128i q = _mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(p, center), positionScale));
+        q = _mm_and_si128(q, xyzMask);
+        _mm_storel_epi64((__m128i*)packed.mPosition, _mm_packs_epi32(q, q));
+
+        __m128 n = _mm_loadu_ps((const float*)(src + offsetof(SKN::Vertex_t, mNormalXYZ)));
+        q = _mm_cvtps_epi32(_mm_max_ps(_mm_mul_ps(n, normalScale), normalMin));
+        q = _mm_and_si128(q, xyzMask);
+        q = _mm_packs_epi32(q, q);
+        int normal = _mm_cvtsi128_si32(_mm_packs_epi16(q, q));
+        memcpy(packed.mNormal, &normal, sizeof(normal));
+
+        __m128 w = _mm_loadu_ps((const float*)(src + offsetof(SKN::Vertex_t, mBoneWeights)));
+        _mm_storeu_si128((__m128i*)weights, _mm_cvtps_epi32(_mm_mul_ps(w, weightScale)));
+#else
+        for (int axis = 0; axis < 3; axis++) {
+            long v = std::lrint((vert.mXYZ[axis] - bounds.center[axis]) * scale[axis]);
+            packed.mPosition[axis] = (short)std::max(-32768L, std::min(32767L, v));
+            v = std::lrint(std::max(vert.mNormalXYZ[axis] * 127.0f, -127.0f));
+            packed.mNormal[axis] = (signed char)std::min(127L, v);
+        }
+        packed.mPosition[3] = 0;
+        packed.mNormal[3] = 0;
+        for (int i = 0; i < 4; i++) {
+            weights[i] = (int)std::lrint(vert.mBoneWeights[i] * 255.0f);
+        }
+#endif
+        // Rounding can leave the sum a bit off, the biggest weight takes up the difference.
+        int sum = 0, biggest = 0;
+        for (int i = 0; i < 4; i++) {
+            weights[i] = std::max(0, std::min(255, weights[i]));
+            sum += weights[i];
+            biggest = weights[i] > weights[biggest] ? i : biggest;
+        }
+        if (sum != 0) {
+            weights[biggest] = std::max(0, std::min(255, weights[biggest] + 255 - sum));
+        }
+        for (int i = 0; i < 4; i++) {
+            packed.mBoneWeights[i] = (unsigned char)weights[i];
+        }
+
+        packed.mUV[0] = floatToHalf(vert.mUV[0]);
+        packed.mUV[1] = floatToHalf(vert.mUV[1]);
+        memcpy(packed.mBoneIndices, vert.mBoneIndices, sizeof(packed.mBoneIndices));
+    }
+    return bounds;
+}
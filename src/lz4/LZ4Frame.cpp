@@ -0,0 +1,382 @@
+#include "LZ4Frame.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    typedef unsigned char Byte;
+
+    // Frame descriptor bits.
+    const Byte FlagVersion = 0x40;
+    const Byte FlagVersionMask = 0xC0;
+    const Byte FlagBlockIndependence = 0x20;
+    const Byte FlagBlockChecksum = 0x10;
+    const Byte FlagContentSize = 0x08;
+    const Byte FlagContentChecksum = 0x04;
+    const Byte FlagReserved = 0x02;
+    const Byte FlagDictionaryId = 0x01;
+    const Byte BlockMaxSize4MB = 0x70;
+
+    const unsigned int UncompressedBlock = 0x80000000u;
+    const size_t BlockSize = 4 << 20;
+
+    // Block format limits: matches are at least 4 long and reach back at most 64K, the last match
+    // starts at least 12 bytes before the end of the block and the last 5 bytes are literals.
+    const size_t MinMatch = 4;
+    const size_t MaxOffset = 65535;
+    const size_t MatchStartLimit = 12;
+    const size_t LastLiterals = 5;
+
+    const unsigned int HashBits = 16;
+
+    unsigned int read32(const Byte* ptr) {
+        return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((unsigned int)ptr[3] << 24);
+    }
+
+    void write32(Byte* ptr, unsigned int value) {
+        ptr[0] = (Byte)value;
+        ptr[1] = (Byte)(value >> 8);
+        ptr[2] = (Byte)(value >> 16);
+        ptr[3] = (Byte)(value >> 24);
+    }
+
+    unsigned int rotl32(unsigned int value, int count) {
+        return (value << count) | (value >> (32 - count));
+    }
+
+    size_t blockBound(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    size_t descriptorSize(Byte flags) {
+        return 2 + (flags & FlagContentSize ? 8 : 0) + (flags & FlagDictionaryId ? 4 : 0);
+    }
+
+    // Lengths of 15 and up spill over into extra bytes of 255 each and a final one below that.
+    Byte* writeLength(Byte* out, size_t length) {
+        while (length >= 255) {
+            *out++ = 255;
+            length -= 255;
+        }
+        *out++ = (Byte)length;
+        return out;
+    }
+
+    bool readLength(const Byte*& in, const Byte* end, size_t& length) {
+        Byte next;
+        do {
+            if (in == end) {
+                return false;
+            }
+            next = *in++;
+            length += next;
+        } while (next == 255);
+        return true;
+    }
+
+    Byte* writeSequence(Byte* out, const Byte* literals, size_t literalCount, size_t offset, size_t matchLength) {
+        auto token = out++;
+        *token = (Byte)(std::min<size_t>(literalCount, 15) << 4);
+        if (literalCount >= 15) {
+            out = writeLength(out, literalCount - 15);
+        }
+        memcpy(out, literals, literalCount);
+        out += literalCount;
+        if (!matchLength) {
+            return out;
+        }
+        out[0] = (Byte)offset;
+        out[1] = (Byte)(offset >> 8);
+        out += 2;
+        *token |= (Byte)std::min<size_t>(matchLength - MinMatch, 15);
+        if (matchLength - MinMatch >= 15) {
+            out = writeLength(out, matchLength - MinMatch - 15);
+        }
+        return out;
+    }
+
+    // Greedy parse with hash chains; attempts is how many earlier positions with the same hash are
+    // looked at for each one. Returns the compressed size.
+    size_t compressBlock(const Byte* src, size_t size, Byte* dst, unsigned int attempts, std::vector<int>& head, std::vector<int>& chain) {
+        auto out = dst;
+        size_t anchor = 0;
+        if (size > MatchStartLimit) {
+            std::fill(head.begin(), head.end(), -1);
+            chain.resize(size);
+            auto hashAt = [&](size_t pos) {
+                return (read32(src + pos) * 2654435761u) >> (32 - HashBits);
+            };
+            size_t inserted = 0;
+            auto insertUpTo = [&](size_t pos) {
+                for (; inserted < pos; inserted++) {
+                    auto hash = hashAt(inserted);
+                    chain[inserted] = head[hash];
+                    head[hash] = (int)inserted;
+                }
+            };
+
+            auto matchLimit = size - LastLiterals;
+            size_t pos = 0;
+            while (pos + MatchStartLimit <= size) {
+                insertUpTo(pos);
+                size_t bestLength = 0;
+                size_t bestPos = 0;
+                auto candidate = head[hashAt(pos)];
+                for (unsigned int attempt = 0; attempt < attempts && candidate >= 0 && pos - candidate <= MaxOffset; attempt++) {
+                    if (read32(src + candidate) == read32(src + pos)) {
+                        auto length = MinMatch;
+                        while (pos + length < matchLimit && src[candidate + length] == src[pos + length]) {
+                            length++;
+                        }
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestPos = candidate;
+                            if (pos + length == matchLimit) {
+                                break;
+                            }
+                        }
+                    }
+                    candidate = chain[candidate];
+                }
+                if (!bestLength) {
+                    pos++;
+                    continue;
+                }
+                // Literals just before a match often belong to it too.
+                while (pos > anchor && bestPos > 0 && pos - bestPos <= MaxOffset && src[pos - 1] == src[bestPos - 1]) {
+                    pos--;
+                    bestPos--;
+                    bestLength++;
+                }
+                out = writeSequence(out, src + anchor, pos - anchor, pos - bestPos, bestLength);
+                pos += bestLength;
+                anchor = pos;
+            }
+        }
+        out = writeSequence(out, src + anchor, size - anchor, 0, 0);
+        return size_t(out - dst);
+    }
+
+    // Decodes one block, appending to dst at position written. Matches may reach back into earlier
+    // blocks, which linked blocks do.
+    bool decompressBlock(const Byte* src, size_t size, Byte* dst, size_t& written, size_t capacity) {
+        auto in = src;
+        auto end = src + size;
+        for (;;) {
+            if (in == end) {
+                return false;
+            }
+            auto token = *in++;
+            size_t literalCount = token >> 4;
+            if (literalCount == 15 && !readLength(in, end, literalCount)) {
+                return false;
+            }
+            if (literalCount > size_t(end - in) || literalCount > capacity - written) {
+                return false;
+            }
+            memcpy(dst + written, in, literalCount);
+            in += literalCount;
+            written += literalCount;
+            if (in == end) {
+                return true;
+            }
+
+            if (end - in < 2) {
+                return false;
+            }
+            size_t offset = in[0] | (in[1] << 8);
+            in += 2;
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(in, end, matchLength)) {
+                return false;
+            }
+            matchLength += MinMatch;
+            if (!offset || offset > written || matchLength > capacity - written) {
+                return false;
+            }
+            auto from = dst + written - offset;
+            auto to = dst + written;
+            if (offset >= matchLength) {
+                memcpy(to, from, matchLength);
+            }
+            else {
+                // Overlapping, repeats the last offset bytes.
+                for (size_t idx = 0; idx < matchLength; idx++) {
+                    to[idx] = from[idx];
+                }
+            }
+            written += matchLength;
+        }
+    }
+}
+
+unsigned int LZ4Frame::hash32(const void* data, size_t size, unsigned int seed) {
+    const unsigned int prime1 = 2654435761u;
+    const unsigned int prime2 = 2246822519u;
+    const unsigned int prime3 = 3266489917u;
+    const unsigned int prime4 = 668265263u;
+    const unsigned int prime5 = 374761393u;
+
+    auto bytes = (const Byte*)data;
+    auto end = bytes + size;
+    unsigned int hash;
+    if (size >= 16) {
+        unsigned int v1 = seed + prime1 + prime2;
+        unsigned int v2 = seed + prime2;
+        unsigned int v3 = seed;
+        unsigned int v4 = seed - prime1;
+        for (; end - bytes >= 16; bytes += 16) {
+            v1 = rotl32(v1 + read32(bytes) * prime2, 13) * prime1;
+            v2 = rotl32(v2 + read32(bytes + 4) * prime2, 13) * prime1;
+            v3 = rotl32(v3 + read32(bytes + 8) * prime2, 13) * prime1;
+            v4 = rotl32(v4 + read32(bytes + 12) * prime2, 13) * prime1;
+        }
+        hash = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+    }
+    else {
+        hash = seed + prime5;
+    }
+    hash += (unsigned int)size;
+    for (; end - bytes >= 4; bytes += 4) {
+        hash = rotl32(hash + read32(bytes) * prime3, 17) * prime4;
+    }
+    for (; bytes < end; bytes++) {
+        hash = rotl32(hash + *bytes * prime5, 11) * prime1;
+    }
+    hash ^= hash >> 15;
+    hash *= prime2;
+    hash ^= hash >> 13;
+    hash *= prime3;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+size_t LZ4Frame::compressBound(size_t size) {
+    // Blocks that do not shrink are stored as they are, so only the framing adds anything: header,
+    // block sizes, end mark and content checksum.
+    auto blocks = size / BlockSize + 1;
+    return 4 + 11 + blocks * 4 + size + 4 + 4;
+}
+
+size_t LZ4Frame::compress(const void* src, size_t size, void* dst, int level) {
+    auto in = (const Byte*)src;
+    auto out = (Byte*)dst;
+
+    write32(out, MagicNumber);
+    auto descriptor = out + 4;
+    descriptor[0] = FlagVersion | FlagBlockIndependence | FlagContentSize | FlagContentChecksum;
+    descriptor[1] = BlockMaxSize4MB;
+    for (int idx = 0; idx < 8; idx++) {
+        descriptor[2 + idx] = (Byte)((unsigned long long)size >> (idx * 8));
+    }
+    descriptor[10] = (Byte)(hash32(descriptor, 10) >> 8);
+    out = descriptor + 11;
+
+    level = std::max(1, std::min(level, 12));
+    auto attempts = 1u << (level - 1);
+    std::vector<int> head(size_t(1) << HashBits);
+    std::vector<int> chain;
+    std::vector<Byte> block(blockBound(std::min(size, BlockSize)));
+    for (size_t first = 0; first < size; first += BlockSize) {
+        auto length = std::min(BlockSize, size - first);
+        auto compressed = compressBlock(in + first, length, block.data(), attempts, head, chain);
+        if (compressed < length) {
+            write32(out, (unsigned int)compressed);
+            memcpy(out + 4, block.data(), compressed);
+            out += 4 + compressed;
+        }
+        else {
+            write32(out, (unsigned int)length | UncompressedBlock);
+            memcpy(out + 4, in + first, length);
+            out += 4 + length;
+        }
+    }
+    write32(out, 0);
+    write32(out + 4, hash32(src, size));
+    out += 8;
+    return size_t(out - (Byte*)dst);
+}
+
+bool LZ4Frame::readHeader(const void* src, size_t size, unsigned long long& contentSize, bool& hasContentSize) {
+    auto in = (const Byte*)src;
+    if (size < 7 || read32(in) != MagicNumber) {
+        return false;
+    }
+    auto flags = in[4];
+    auto blockMax = in[5];
+    if ((flags & FlagVersionMask) != FlagVersion || (flags & FlagReserved) ||
+        (blockMax & 0x8F) || (blockMax >> 4) < 4) {
+        return false;
+    }
+    auto length = descriptorSize(flags);
+    if (size < 4 + length + 1 || in[4 + length] != (Byte)(hash32(in + 4, length) >> 8)) {
+        return false;
+    }
+    hasContentSize = (flags & FlagContentSize) != 0;
+    contentSize = 0;
+    if (hasContentSize) {
+        for (int idx = 0; idx < 8; idx++) {
+            contentSize |= (unsigned long long)in[6 + idx] << (idx * 8);
+        }
+    }
+    return true;
+}
+
+bool LZ4Frame::decompress(const void* src, size_t size, void* dst, size_t contentSize) {
+    unsigned long long recordedSize;
+    bool hasContentSize;
+    if (!readHeader(src, size, recordedSize, hasContentSize)) {
+        return false;
+    }
+    auto in = (const Byte*)src;
+    auto end = in + size;
+    auto flags = in[4];
+    // Dictionaries are not supported.
+    if (flags & FlagDictionaryId) {
+        return false;
+    }
+    auto maxBlock = size_t(1) << (8 + 2 * (in[5] >> 4));
+    in += 4 + descriptorSize(flags) + 1;
+
+    auto out = (Byte*)dst;
+    size_t written = 0;
+    for (;;) {
+        if (end - in < 4) {
+            return false;
+        }
+        auto blockSize = read32(in);
+        in += 4;
+        if (!blockSize) {
+            break;
+        }
+        auto length = size_t(blockSize & ~UncompressedBlock);
+        if (length > maxBlock || length > size_t(end - in)) {
+            return false;
+        }
+        if (blockSize & UncompressedBlock) {
+            if (length > contentSize - written) {
+                return false;
+            }
+            memcpy(out + written, in, length);
+            written += length;
+        }
+        else if (!decompressBlock(in, length, out, written, contentSize)) {
+            return false;
+        }
+        if (flags & FlagBlockChecksum) {
+            if (size_t(end - in) - length < 4 || read32(in + length) != hash32(in, length)) {
+                return false;
+            }
+            in += 4;
+        }
+        in += length;
+    }
+    if (flags & FlagContentChecksum) {
+        if (end - in < 4 || read32(in) != hash32(dst, written)) {
+            return false;
+        }
+    }
+    return written == contentSize && (!hasContentSize || recordedSize == contentSize);
+}
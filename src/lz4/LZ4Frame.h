@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// The LZ4 frame format (lz4 v1.x, https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md),
+// enough of it for archive entries: frames are written with independent 4MB blocks, the content size
+// and a content checksum. Reading takes any single frame without a dictionary id, linked blocks and
+// block checksums included, as long as it records its content size.
+namespace LZ4Frame
+{
+    const unsigned int MagicNumber = 0x184D2204;
+
+    // Most compress can write for size bytes of input.
+    size_t compressBound(size_t size);
+    // level 1 takes the first match found, higher levels search longer for better ones, up to 12.
+    // Returns the size of the frame written to dst, which must hold compressBound(size) bytes.
+    size_t compress(const void* src, size_t size, void* dst, int level);
+
+    // Checks the frame header, including its checksum. False if src does not start with a valid one.
+    // hasContentSize is false for frames that do not record it, contentSize is 0 then.
+    bool readHeader(const void* src, size_t size, unsigned long long& contentSize, bool& hasContentSize);
+    // Decodes the whole frame into dst, which has room for exactly contentSize bytes. False if the
+    // frame is broken, does not decode to contentSize bytes or fails its checksums.
+    bool decompress(const void* src, size_t size, void* dst, size_t contentSize);
+
+    // xxHash32, which the frame format uses for its checksums.
+    unsigned int hash32(const void* data, size_t size, unsigned int seed = 0);
+}
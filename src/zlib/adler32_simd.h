@@ -0,0 +1,20 @@
+/* adler32_simd.h -- SSSE3 Adler-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef ADLER32_SIMD_H
+#define ADLER32_SIMD_H
+
+#include "cpu_features.h"
+
+#ifdef Z_X86_SIMD
+
+/* Below this the setup costs more than the vector loop saves. */
+#define Z_ADLER32_SIMD_MINIMUM_LENGTH 64
+
+/* Same result as adler32(), for any length. Needs x86_cpu_has_ssse3. */
+uLong ZLIB_INTERNAL adler32_simd OF((uLong adler, const Bytef *buf, uInt len));
+
+#endif
+
+#endif /* ADLER32_SIMD_H */
@@ -0,0 +1,63 @@
+/* cpu_features.c -- runtime detection of x86 SIMD extensions
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "cpu_features.h"
+
+#ifdef Z_X86_SIMD
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#  include <windows.h>
+#else
+#  include <cpuid.h>
+#  include <pthread.h>
+#endif
+
+int ZLIB_INTERNAL x86_cpu_has_ssse3 = 0;
+int ZLIB_INTERNAL x86_cpu_has_pclmul = 0;
+
+local void detect_features(void)
+{
+    unsigned ecx;
+#if defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 1);
+    ecx = (unsigned)regs[2];
+#else
+    unsigned eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return;
+#endif
+    x86_cpu_has_ssse3 = (ecx >> 9) & 1;
+    /* The CRC folding also uses SSE4.1 for the final extract. */
+    x86_cpu_has_pclmul = ((ecx >> 1) & 1) && ((ecx >> 19) & 1);
+}
+
+#if defined(_MSC_VER)
+
+local INIT_ONCE features_once = INIT_ONCE_STATIC_INIT;
+
+local BOOL CALLBACK detect_features_once(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    detect_features();
+    return TRUE;
+}
+
+void ZLIB_INTERNAL cpu_check_features(void)
+{
+    InitOnceExecuteOnce(&features_once, detect_features_once, NULL, NULL);
+}
+
+#else
+
+local pthread_once_t features_once = PTHREAD_ONCE_INIT;
+
+void ZLIB_INTERNAL cpu_check_features(void)
+{
+    pthread_once(&features_once, detect_features);
+}
+
+#endif
+
+#endif /* Z_X86_SIMD */
@@ -0,0 +1,37 @@
+/* cpu_features.h -- runtime detection of x86 SIMD extensions
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include "zutil.h"
+
+/* The SIMD kernels are x86 only, and can be left out by defining Z_NO_SIMD. */
+#if !defined(Z_NO_SIMD) && \
+    (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#  define Z_X86_SIMD
+#endif
+
+#ifdef Z_X86_SIMD
+
+/* GCC and Clang only emit SSSE3/SSE4.1/PCLMUL code for functions that ask
+   for it, so the baseline build keeps running on any x86. MSVC does not
+   need to be told. */
+#if defined(__GNUC__) || defined(__clang__)
+#  define Z_TARGET(features) __attribute__((target(features)))
+#else
+#  define Z_TARGET(features)
+#endif
+
+/* Set once by cpu_check_features(), read by the checksum routines. */
+extern int ZLIB_INTERNAL x86_cpu_has_ssse3;
+extern int ZLIB_INTERNAL x86_cpu_has_pclmul; /* PCLMULQDQ and SSE4.1 */
+
+/* Runs CPUID the first time it is called, later calls return immediately.
+   Safe to call from several threads at once. */
+void ZLIB_INTERNAL cpu_check_features OF((void));
+
+#endif /* Z_X86_SIMD */
+
+#endif /* CPU_FEATURES_H */
@@ -29,6 +29,7 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "crc32_simd.h"
 
 #define local static
 
@@ -208,6 +209,21 @@ unsigned long ZEXPORT crc32(crc, buf, len)
 {
     if (buf == Z_NULL) return 0UL;
 
+#ifdef Z_X86_SIMD
+    if (len >= Z_CRC32_SIMD_MINIMUM_LENGTH) {
+        cpu_check_features();
+        if (x86_cpu_has_pclmul) {
+            /* Whole 16 byte blocks here, the rest goes through the tables. */
+            uInt chunk = len & ~(uInt)Z_CRC32_SIMD_CHUNK_MASK;
+            crc = ~(unsigned long)crc32_simd(buf, chunk, (z_crc_t)~crc) & 0xffffffffUL;
+            len -= chunk;
+            if (!len)
+                return crc;
+            buf += chunk;
+        }
+    }
+#endif
+
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
         make_crc_table();
@@ -0,0 +1,22 @@
+/* crc32_simd.h -- PCLMULQDQ CRC-32
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CRC32_SIMD_H
+#define CRC32_SIMD_H
+
+#include "cpu_features.h"
+
+#ifdef Z_X86_SIMD
+
+/* crc32_simd wants at least this many bytes, in multiples of 16. */
+#define Z_CRC32_SIMD_MINIMUM_LENGTH 64
+#define Z_CRC32_SIMD_CHUNK_MASK 15
+
+/* Takes and returns the crc in its inverted, in-progress form (i.e. as
+   crc32() uses it between the two final xors). Needs x86_cpu_has_pclmul. */
+z_crc_t ZLIB_INTERNAL crc32_simd OF((const unsigned char FAR *buf, uInt len, z_crc_t crc));
+
+#endif
+
+#endif /* CRC32_SIMD_H */
@@ -0,0 +1,301 @@
+/* inffast_chunk.c -- fast decoding with a wide bit buffer and chunked copies
+ * Copyright (C) 1995-2008, 2010, 2013 Mark Adler
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * Same decoding loop as inffast.c, with two changes:
+ *
+ * - The bit buffer is 64 bits wide and is topped up once per code with an
+ *   unaligned eight byte load, which always leaves at least 56 bits. One
+ *   length/distance pair needs at most 48, so there are no further checks
+ *   for input inside the loop. The bits loaded past the count are the next
+ *   bits of the stream, so loading them again later changes nothing.
+ *
+ * - Matches are copied sixteen bytes at a time. A copy can run up to
+ *   fifteen bytes past its end, which is fine because the next code
+ *   overwrites them and there is INFLATE_CHUNK_SIZE bytes of slack after
+ *   the longest match. Overlapping matches (distance below sixteen) first
+ *   repeat the pattern by doubling until it is at least a chunk long.
+ *
+ * The window is only ever read with exact length copies, so the loads
+ * never leave the allocation.
+ */
+
+#include "zutil.h"
+#include "inftrees.h"
+#include "inflate.h"
+#include "inffast_chunk.h"
+
+#ifdef INFLATE_CHUNK_SIMD
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define INFLATE_CHUNK_SSE2
+#endif
+
+typedef unsigned long long inflate_holder_t;
+
+local inflate_holder_t read64le(const unsigned char FAR *in)
+{
+    inflate_holder_t v;
+    zmemcpy((Bytef *)&v, (const Bytef *)in, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+local void chunk_copy1(unsigned char FAR *out, const unsigned char FAR *from)
+{
+#ifdef INFLATE_CHUNK_SSE2
+    _mm_storeu_si128((__m128i *)out, _mm_loadu_si128((const __m128i *)from));
+#else
+    memcpy(out, from, INFLATE_CHUNK_SIZE);
+#endif
+}
+
+/* Copies len bytes from out - dist to out, for any dist of at least one.
+   Returns the new end of output. May write up to INFLATE_CHUNK_SIZE - 1
+   bytes past it. */
+local unsigned char FAR *chunk_copy(unsigned char FAR *out, unsigned dist,
+                                    unsigned len)
+{
+    const unsigned char FAR *from = out - dist;
+
+    /* [from, out) repeats with period dist, so it can be copied whole
+       onto out without overlapping, which doubles the repeated run */
+    while (dist < INFLATE_CHUNK_SIZE && dist < len) {
+        memcpy(out, from, dist);
+        out += dist;
+        len -= dist;
+        dist += dist;
+    }
+    if (dist >= INFLATE_CHUNK_SIZE) {
+        /* each chunk reads only bytes written before it */
+        for (;;) {
+            chunk_copy1(out, from);
+            if (len <= INFLATE_CHUNK_SIZE)
+                return out + len;
+            out += INFLATE_CHUNK_SIZE;
+            from += INFLATE_CHUNK_SIZE;
+            len -= INFLATE_CHUNK_SIZE;
+        }
+    }
+    memcpy(out, from, len);
+    return out + len;
+}
+
+/*
+   Decode literal, length, and distance codes and write out the resulting
+   literal and match bytes until either not enough input or output is
+   available, an end-of-block is encountered, or a data error is encountered.
+   Has the same contract as inflate_fast(), except that on entry:
+
+        strm->avail_in >= INFLATE_FAST_MIN_INPUT
+        strm->avail_out >= INFLATE_FAST_MIN_OUTPUT
+ */
+void ZLIB_INTERNAL inflate_fast_chunk(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *in;      /* local strm->next_in */
+    z_const unsigned char FAR *last;    /* have enough input while in < last */
+    z_const unsigned char FAR *in_end;  /* end of strm->next_in */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+    unsigned char FAR *out_end; /* end of strm->next_out */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned wnext;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    inflate_holder_t hold;      /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code here;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    in_end = in + strm->avail_in;
+    last = in_end - (INFLATE_FAST_MIN_INPUT - 1);
+    out = strm->next_out;
+    out_end = out + strm->avail_out;
+    beg = out - (start - strm->avail_out);
+    end = out_end - (INFLATE_FAST_MIN_OUTPUT - 1);
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    wnext = state->wnext;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        hold |= read64le(in) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
+        here = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(here.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(here.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", here.val));
+            *out++ = (unsigned char)(here.val);
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(here.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            here = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(here.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(here.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(here.val);
+                op &= 15;                       /* number of extra bits */
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        if (state->sane) {
+                            strm->msg =
+                                (char *)"invalid distance too far back";
+                            state->mode = BAD;
+                            break;
+                        }
+#ifdef INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR
+                        if (len <= op - whave) {
+                            zmemzero(out, len);
+                            out += len;
+                            continue;
+                        }
+                        len -= op - whave;
+                        zmemzero(out, op - whave);
+                        out += op - whave;
+                        op = whave;
+                        if (op == 0) {
+                            out = chunk_copy(out, dist, len);
+                            continue;
+                        }
+#endif
+                    }
+                    from = window;
+                    if (wnext == 0) {           /* very common case */
+                        from += wsize - op;
+                    }
+                    else if (wnext < op) {      /* wrap around window */
+                        from += wsize + wnext - op;
+                        op -= wnext;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            zmemcpy(out, from, op);
+                            out += op;
+                            from = window;
+                            op = wnext;
+                        }
+                    }
+                    else {                      /* contiguous in window */
+                        from += wnext - op;
+                    }
+                    if (op < len) {             /* some from window */
+                        len -= op;
+                        zmemcpy(out, from, op);
+                        out += op;
+                        out = chunk_copy(out, dist, len);   /* rest from output */
+                    }
+                    else {
+                        zmemcpy(out, from, len);
+                        out += len;
+                    }
+                }
+                else
+                    out = chunk_copy(out, dist, len);   /* copy direct from output */
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                here = dcode[here.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            here = lcode[here.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes (on entry, bits < 8, so in won't go too far back) */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= ((inflate_holder_t)1 << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = (z_const unsigned char FAR *)in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in_end - in);
+    strm->avail_out = (unsigned)(out_end - out);
+    state->hold = (unsigned long)hold;
+    state->bits = bits;
+    return;
+}
+
+#endif /* INFLATE_CHUNK_SIMD */
@@ -0,0 +1,35 @@
+/* inffast_chunk.h -- header to use inffast_chunk.c
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef INFFAST_CHUNK_H
+#define INFFAST_CHUNK_H
+
+#include "inffast.h"
+
+/* inflate_fast_chunk() is an alternative to inflate_fast() that is built
+   when INFLATE_CHUNK_SIMD is defined. It keeps a 64-bit bit buffer that is
+   refilled eight bytes at a time, and copies matches sixteen bytes at a
+   time. Both read and write a little past what they use, so it needs more
+   room on either side than inflate_fast() does. The decoded output is the
+   same, but the bytes between next_out and next_out + avail_out may be
+   scribbled on. Only little-endian targets are supported. */
+
+#ifdef INFLATE_CHUNK_SIMD
+
+/* A match is at most 258 bytes and a chunked copy overshoots by at most
+   INFLATE_CHUNK_SIZE - 1. */
+#define INFLATE_CHUNK_SIZE 16
+#define INFLATE_FAST_MIN_INPUT 8
+#define INFLATE_FAST_MIN_OUTPUT (258 + INFLATE_CHUNK_SIZE)
+
+void ZLIB_INTERNAL inflate_fast_chunk OF((z_streamp strm, unsigned start));
+
+#endif
+
+#endif /* INFFAST_CHUNK_H */
@@ -84,6 +84,7 @@
 #include "inftrees.h"
 #include "inflate.h"
 #include "inffast.h"
+#include "inffast_chunk.h"
 
 #ifdef MAKEFIXED
 #  ifndef BUILDFIXED
@@ -1019,9 +1020,16 @@ int flush;
         case LEN_:
             state->mode = LEN;
         case LEN:
+#ifdef INFLATE_CHUNK_SIMD
+            if (have >= INFLATE_FAST_MIN_INPUT &&
+                left >= INFLATE_FAST_MIN_OUTPUT) {
+                RESTORE();
+                inflate_fast_chunk(strm, out);
+#else
             if (have >= 6 && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);
+#endif
                 LOAD();
                 if (state->mode == TYPE)
                     state->back = -1;
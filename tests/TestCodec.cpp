@@ -0,0 +1,130 @@
+#include "TestUtil.h"
+
+#include "RiotFiles/RiotArchiveFile.h"
+#include "RiotFiles/RiotCodec.h"
+
+static void checkRoundTrip(const RiotCodec& codec, const std::vector<char>& contents) {
+    std::vector<char> compressed;
+    codec.compress(contents.data(), contents.size(), compressed);
+    CHECK(codec.isEncoded(compressed.data(), compressed.size()));
+
+    std::vector<char> grown;
+    CHECK(codec.decompress(compressed.data(), compressed.size(), nullptr, 0, &grown) == contents.size());
+    CHECK(grown == contents);
+
+    std::vector<char> exact(contents.size());
+    CHECK(codec.decompress(compressed.data(), compressed.size(), exact.data(), exact.size(), nullptr) == contents.size());
+    CHECK(exact == contents);
+
+    // Too small a buffer gets the start, the full size is still reported.
+    if (contents.size() > 10) {
+        std::vector<char> partial(10);
+        CHECK(codec.decompress(compressed.data(), compressed.size(), partial.data(), partial.size(), nullptr) == contents.size());
+        CHECK(std::equal(partial.begin(), partial.end(), contents.begin()));
+    }
+
+    // Cut short past the frame header it is still recognized, and rejected.
+    CHECK_THROWS(codec.decompress(compressed.data(), compressed.size() - 1, nullptr, 0, &grown));
+    if (compressed.size() > 64) {
+        CHECK_THROWS(codec.decompress(compressed.data(), compressed.size() / 2, nullptr, 0, &grown));
+    }
+}
+
+static void testCodecs() {
+    std::vector<std::shared_ptr<const RiotCodec>> codecs;
+    codecs.push_back(RiotCodec::zlib());
+    codecs.push_back(RiotCodec::zlib(1));
+    codecs.push_back(RiotCodec::zstd());
+    codecs.push_back(RiotCodec::zstd(1));
+    codecs.push_back(RiotCodec::lz4());
+    codecs.push_back(RiotCodec::lz4(1));
+    size_t sizes[] = { 0, 1, 13, 1000, 70000, (5 << 20) + 7 };
+    for (const auto& codec : codecs) {
+        for (auto size : sizes) {
+            checkRoundTrip(*codec, makeContents(size, (unsigned int)size));
+        }
+    }
+
+    CHECK(RiotCodec::zlib()->getEncoding() == RAFEncoding::zlib);
+    CHECK(RiotCodec::zstd()->getEncoding() == RAFEncoding::zstd);
+    CHECK(RiotCodec::lz4()->getEncoding() == RAFEncoding::lz4);
+    CHECK(RiotCodec::getBuiltinCodecs().size() == 3);
+
+    // Data that only starts like a frame is not the codec's.
+    std::vector<char> fake(64, 'x');
+    fake[0] = 0x04; fake[1] = 0x22; fake[2] = 0x4D; fake[3] = 0x18;
+    CHECK(RiotCodec::lz4()->decompress(fake.data(), fake.size(), nullptr, 0, nullptr) == RiotCodec::NotEncoded);
+    fake[0] = 0x28; fake[1] = (char)0xB5; fake[2] = 0x2F; fake[3] = (char)0xFD; fake[4] = (char)0xFF;
+    CHECK(RiotCodec::zstd()->decompress(fake.data(), fake.size(), nullptr, 0, nullptr) == RiotCodec::NotEncoded);
+}
+
+static std::vector<std::string> writeSamples(size_t count) {
+    std::vector<std::string> paths;
+    for (size_t idx = 0; idx < count; idx++) {
+        auto path = testPath("sample" + std::to_string(idx));
+        writeFile(path, makeContents(600 + idx % 300, 7));
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+static void testDictionary() {
+    auto samples = writeSamples(300);
+    auto dictionary = RiotCodec::trainZstdDictionary(samples, 16384);
+    CHECK(!dictionary.empty() && dictionary.size() <= 16384);
+
+    checkRoundTrip(*RiotCodec::zstd(19, dictionary), makeContents(700, 7));
+    checkRoundTrip(*RiotCodec::zstd(3, dictionary), makeContents(100000, 9));
+
+    // Frames made with a dictionary need it, plain ones read fine with or without.
+    std::vector<char> compressed;
+    auto contents = makeContents(800, 7);
+    RiotCodec::zstd(19, dictionary)->compress(contents.data(), contents.size(), compressed);
+    CHECK_THROWS(RiotCodec::zstd()->decompress(compressed.data(), compressed.size(), nullptr, 0, nullptr));
+    RiotCodec::zstd()->compress(contents.data(), contents.size(), compressed);
+    std::vector<char> grown;
+    RiotCodec::zstd(19, dictionary)->decompress(compressed.data(), compressed.size(), nullptr, 0, &grown);
+    CHECK(grown == contents);
+
+    // Stored with the archive and picked up by whoever opens it next.
+    auto archivePath = makeArchive("Dictionary.raf");
+    {
+        RiotArchiveFile archive(archivePath);
+        CHECK(!archive.getDictionaryCodec());
+        archive.setZstdDictionary(dictionary);
+        for (size_t idx = 0; idx < 20; idx++) {
+            archive.addFile("small/" + std::to_string(idx), samples[idx]);
+        }
+        archive.addFile("zlib", samples[20], RiotCodec::zlib());
+        archive.addFile("lz4", samples[21], RiotCodec::lz4());
+        archive.apply();
+    }
+    RiotArchiveFile archive(archivePath);
+    CHECK(archive.getDictionaryCodec() != nullptr);
+    CHECK(archive.hasFile(RiotArchiveFile::ZstdDictionaryPath));
+    CHECK(archive.getFileEncoding(archive.getFileIndex(RiotArchiveFile::ZstdDictionaryPath)) == RAFEncoding::stored);
+    for (size_t idx = 0; idx < 20; idx++) {
+        auto fileIdx = archive.getFileIndex("small/" + std::to_string(idx));
+        CHECK(archive.getFileEncoding(fileIdx) == RAFEncoding::zstd);
+        CHECK(archive.getFileContents(fileIdx) == makeContents(600 + idx % 300, 7));
+    }
+    CHECK(archive.getFileEncoding(archive.getFileIndex("zlib")) == RAFEncoding::zlib);
+    CHECK(archive.getFileContents(archive.getFileIndex("zlib")) == makeContents(620, 7));
+    CHECK(archive.getFileEncoding(archive.getFileIndex("lz4")) == RAFEncoding::lz4);
+    CHECK(archive.getFileContents(archive.getFileIndex("lz4")) == makeContents(621, 7));
+
+    // The dictionary survives a rewrite, and a collection reads through it too.
+    RiotArchiveFile rewritten(archivePath);
+    rewritten.removeFile("zlib");
+    rewritten.apply();
+    RiotArchiveFileCollection collection(true);
+    collection.addArchive(archivePath);
+    CHECK(!collection.hasFile("zlib"));
+    CHECK(collection.getFileContents(collection.getFileIndex("small/3")) == makeContents(603, 7));
+}
+
+int main() {
+    testCodecs();
+    testDictionary();
+    return testResult();
+}
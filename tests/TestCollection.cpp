@@ -0,0 +1,123 @@
+#include "TestUtil.h"
+
+#include "RiotFiles/RiotArchiveFile.h"
+
+#include <thread>
+
+// An archive holding each of paths, contents made from the path's length.
+static std::string makeArchiveWith(const std::string& name, const std::vector<std::string>& paths, unsigned int seed) {
+    auto archivePath = makeArchive(name);
+    RiotArchiveFile archive(archivePath);
+    for (const auto& path : paths) {
+        auto sourcePath = testPath(name + ".source" + std::to_string(archive.getFileCount()) + std::to_string(path.size()));
+        writeFile(sourcePath, makeContents(1000 + path.size(), seed));
+        archive.addFile(path, sourcePath);
+    }
+    archive.apply();
+    return archivePath;
+}
+
+static std::vector<std::string> paths(const char* first, const char* second) {
+    std::vector<std::string> result;
+    result.push_back(first);
+    result.push_back(second);
+    return result;
+}
+
+static void testAddAfterLoadIndex() {
+    auto first = makeArchiveWith("First.raf", paths("data/a", "data/shared"), 1);
+    auto second = makeArchiveWith("Second.raf", paths("data/bb", "data/ccc"), 2);
+    auto third = makeArchiveWith("Third.raf", paths("data/dddd", "data/shared"), 3);
+    auto indexPath = testPath("Collection.idx");
+    {
+        RiotArchiveFileCollection collection(true);
+        collection.addArchive(first);
+        collection.addArchive(second);
+        collection.saveIndex(indexPath);
+    }
+
+    RiotArchiveFileCollection collection(true);
+    CHECK(collection.loadIndex(indexPath));
+    CHECK(collection.hasFile("data/ccc"));
+    // The loaded index would not know about its files.
+    CHECK_THROWS(collection.addArchive(third));
+    CHECK(collection.archives.size() == 2);
+    CHECK(!collection.hasFile("data/dddd"));
+
+    collection.rebuildIndex();
+    collection.addArchive(third);
+    CHECK(collection.hasFile("data/dddd"));
+    CHECK(collection.getFileContents(collection.getFileIndex("data/dddd")) == makeContents(1009, 3));
+    CHECK(collection.getFileContents(collection.getFileIndex("data/shared")) == makeContents(1011, 3));
+    CHECK(collection.getFileContents(collection.getFileIndex("data/a")) == makeContents(1006, 1));
+}
+
+static void testConcurrentLazyOpen() {
+    auto first = makeArchiveWith("LazyFirst.raf", paths("lazy/a", "lazy/bb"), 4);
+    auto second = makeArchiveWith("LazySecond.raf", paths("lazy/ccc", "lazy/dddd"), 5);
+    auto indexPath = testPath("Lazy.idx");
+    {
+        RiotArchiveFileCollection collection(true);
+        collection.addArchive(first);
+        collection.addArchive(second);
+        collection.saveIndex(indexPath);
+    }
+
+    RiotArchiveFileCollection collection(true);
+    CHECK(collection.loadIndex(indexPath));
+    CHECK(!collection.archives[0] && !collection.archives[1]);
+    std::vector<int> mismatches(8);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < mismatches.size(); thread++) {
+        threads.push_back(std::thread([&collection, &mismatches, thread]() {
+            for (size_t fileIdx = 0; fileIdx < collection.getFileCount(); fileIdx++) {
+                auto name = collection.getFileName(fileIdx);
+                auto seed = name.compare(0, 7, "lazy/cc") && name.compare(0, 7, "lazy/dd") ? 4 : 5;
+                mismatches[thread] += collection.getFileContents(fileIdx) != makeContents(1000 + name.size(), seed);
+            }
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto count : mismatches) {
+        CHECK(count == 0);
+    }
+    CHECK(collection.archives[0] && collection.archives[1]);
+}
+
+static void testCacheAfterApply() {
+    auto archivePath = makeArchiveWith("Cached.raf", paths("cached/a", "cached/bb"), 6);
+    RiotArchiveFileCollection collection(true);
+    collection.addArchive(archivePath);
+    collection.enableCache(1 << 20, 1);
+    auto fileIdx = collection.getFileIndex("cached/a");
+    CHECK(collection.getFileContents(fileIdx) == makeContents(1008, 6));
+    CHECK(collection.getFileContents(fileIdx) == makeContents(1008, 6));
+    CHECK(collection.getCache()->getStats().hits == 1);
+
+    // Changed through the collection's own archive: never served stale, even before rebuildIndex.
+    auto changedPath = testPath("Cached.changed");
+    writeFile(changedPath, makeContents(3000, 7));
+    auto archive = collection.archivesNamed[archivePath];
+    archive->addFile("cached/a", changedPath);
+    archive->apply();
+    fileIdx = collection.getFileIndex("cached/a");
+    CHECK(collection.getFileContents(fileIdx) == makeContents(3000, 7));
+    CHECK(collection.getCache()->getStats().entries == 2);
+
+    // rebuildIndex drops the contents from before apply along with everything else cached.
+    collection.rebuildIndex();
+    CHECK(collection.getCache()->getStats().entries == 0);
+    CHECK(collection.getCache()->getStats().bytes == 0);
+    fileIdx = collection.getFileIndex("cached/a");
+    CHECK(collection.getFileContents(fileIdx) == makeContents(3000, 7));
+    CHECK(collection.getCache()->getStats().entries == 1);
+}
+
+int main() {
+    testAddAfterLoadIndex();
+    testCacheAfterApply();
+    testConcurrentLazyOpen();
+    return testResult();
+}
@@ -0,0 +1,80 @@
+#include "TestUtil.h"
+
+#include "RiotFiles/riotfiles.h"
+
+#include <cstring>
+
+template <typename T>
+static void put(std::vector<char>& out, const T& value) {
+    out.insert(out.end(), (const char*)&value, (const char*)&value + sizeof(value));
+}
+
+// A version 2 SKN with one material over vertexCount vertices.
+static std::vector<char> makeSkn(unsigned int vertexCount, unsigned int indexCount) {
+    std::vector<char> skn;
+    SKN::Header_t header = { 0x112233, 2 };
+    put(skn, header);
+    SKN::TableOfContents_t toc = { 1, 1 };
+    put(skn, toc);
+    SKN::MaterialHeader_t material;
+    memset(&material, 0, sizeof(material));
+    strcpy(material.mMaterialName, "material");
+    material.mVertexCount = vertexCount;
+    material.mIndexCount = indexCount;
+    put(skn, material);
+    SKN::MeshHeader_t mesh = { indexCount, vertexCount };
+    put(skn, mesh);
+    for (unsigned int idx = 0; idx < indexCount; idx++) {
+        put(skn, (unsigned short)(idx % vertexCount));
+    }
+    for (unsigned int idx = 0; idx < vertexCount; idx++) {
+        SKN::Vertex_t vertex;
+        memset(&vertex, 0, sizeof(vertex));
+        vertex.mXYZ[0] = (float)idx;
+        vertex.mBoneWeights[0] = 1.0f;
+        put(skn, vertex);
+    }
+    SKN::EndData_t end = { 0, 0, 0 };
+    put(skn, end);
+    return skn;
+}
+
+static void testOddOffsetStoredSkin() {
+    auto skn = makeSkn(50, 150);
+    auto sknPath = testPath("mesh.skn");
+    writeFile(sknPath, skn);
+    auto padPath = testPath("pad");
+    writeFile(padPath, std::string("x"));
+
+    auto archivePath = makeArchive("Skins.raf");
+    {
+        RiotArchiveFile archive(archivePath);
+        archive.addFile("data/a.pad", padPath, RiotCodec::stored());
+        archive.addFile("data/b.skn", sknPath, RiotCodec::stored());
+        archive.apply();
+    }
+    RiotArchiveFile archive(archivePath);
+    auto fileIdx = archive.getFileIndex("data/b.skn");
+    CHECK(archive.getFileEncoding(fileIdx) == RAFEncoding::stored);
+    // The setup this is about: the view into the .dat file starts at an odd address.
+    CHECK(((uintptr_t)archive.getFileView(fileIdx).data() & 1) == 1);
+
+    auto view = loadRiotSkinView(&archive, "data/b.skn");
+    CHECK(view.vertices().size() == 50 && view.indices().size() == 150);
+    CHECK(view.materials().size() == 1 && strcmp(view.materials()[0].mMaterialName, "material") == 0);
+    CHECK(view.indices()[149] == 149 % 50);
+    CHECK(view.vertices()[49].mXYZ[0] == 49.0f);
+    CHECK(view.getEndData() != nullptr);
+
+    // Compressed files land in their own buffer and are not copied again.
+    RiotArchiveFile compressed(archivePath);
+    compressed.addFile("data/b.skn", sknPath, RiotCodec::zlib());
+    compressed.apply();
+    auto compressedView = loadRiotSkinView(&compressed, "data/b.skn");
+    CHECK(compressedView.vertices()[7].mXYZ[0] == 7.0f);
+}
+
+int main() {
+    testOddOffsetStoredSkin();
+    return testResult();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RiotFiles/Platform.h"
+#include "RiotFiles/RiotArchiveFile.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Minimal harness: CHECK records a failure and carries on, main returns testResult().
+static int testFailures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); testFailures++; } } while (0)
+
+#define CHECK_THROWS(expr) do { bool thrown = false; try { expr; } catch (const std::exception&) { thrown = true; } CHECK(thrown && #expr); } while (0)
+
+inline int testResult() {
+    std::printf(testFailures ? "%d check(s) failed\n" : "All checks passed\n", testFailures);
+    return testFailures ? 1 : 0;
+}
+
+// Fresh path under the test's own data directory.
+inline std::string testPath(const std::string& name) {
+    Platform::createDirectories(TEST_DATA_DIR);
+    auto path = std::string(TEST_DATA_DIR) + "/" + name;
+    Platform::deleteFile(path);
+    return path;
+}
+
+inline void writeFile(const std::string& path, const std::vector<char>& contents) {
+    FILE* file = Platform::openFile(path, "wb");
+    if (file) {
+        std::fwrite(contents.data(), 1, contents.size(), file);
+        std::fclose(file);
+    }
+}
+
+inline void writeFile(const std::string& path, const std::string& contents) {
+    writeFile(path, std::vector<char>(contents.begin(), contents.end()));
+}
+
+// Compressible but not trivially so.
+inline std::vector<char> makeContents(size_t size, unsigned int seed) {
+    static const char words[] = "mesh skin bone anim texture material vertex index weight ";
+    std::vector<char> contents(size);
+    for (size_t idx = 0; idx < size; idx++) {
+        seed = seed * 1103515245u + 12345u;
+        contents[idx] = (seed >> 27) ? words[(idx + (seed >> 29)) % (sizeof(words) - 1)] : (char)(seed >> 16);
+    }
+    return contents;
+}
+
+// A new empty archive, along with its .dat file.
+inline std::string makeArchive(const std::string& name) {
+    auto path = testPath(name);
+    Platform::deleteFile(path + ".dat");
+    RiotArchiveFile::createEmptyFile(path);
+    return path;
+}